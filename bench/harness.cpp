@@ -0,0 +1,182 @@
+#include "harness.h"
+
+#include "git2cpp/initializer.h"
+#include "git2cpp/metrics.h"
+#include "git2cpp/pmr_initializer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace bench
+{
+    namespace
+    {
+        struct Benchmark
+        {
+            const char * name;
+            benchmark_t fn;
+        };
+
+        std::vector<Benchmark> & registry()
+        {
+            static std::vector<Benchmark> benchmarks;
+            return benchmarks;
+        }
+
+        const char * option(const char * arg, const char * name)
+        {
+            const size_t len = std::strlen(name);
+            return std::strncmp(arg, name, len) == 0 ? arg + len : nullptr;
+        }
+
+        void usage(const char * argv0)
+        {
+            fprintf(stderr,
+                    "usage: %s [options] [filter]\n"
+                    "\t--repo-dir=<dir>        where the synthetic repository is generated and reused\n"
+                    "\t--files=<n>             files in the worktree (default 100000)\n"
+                    "\t--commits=<n>           commits of history (default 1000)\n"
+                    "\t--refs=<n>              tags (default 10000)\n"
+                    "\t--min-time=<seconds>    minimal measured time per benchmark (default 1)\n"
+                    "\t--allocator=pool        route libgit2 allocations to a pmr pool\n"
+                    "\t--trace=<file>          write instrumented calls as Chrome trace JSON\n"
+                    "only benchmarks whose name contains the filter are run\n",
+                    argv0);
+        }
+    }
+
+    Registrar::Registrar(const char * name, benchmark_t fn)
+    {
+        registry().push_back({name, fn});
+    }
+
+    Context::Context(std::string repo_path, Shape const & shape, double min_seconds, const char * suite)
+        : repo_path_(std::move(repo_path))
+        , shape_(shape)
+        , min_seconds_(min_seconds)
+        , suite_(suite)
+    {
+    }
+
+    void Context::measure(const char * label, size_t items, std::function<void()> const & body)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // the first run warms up the page cache and libgit2 caches and is not counted
+        body();
+
+        std::vector<double> seconds;
+        double total = 0;
+        while (seconds.size() < 3 || (total < min_seconds_ && seconds.size() < 1000))
+        {
+            const auto start = clock::now();
+            body();
+            seconds.push_back(std::chrono::duration<double>(clock::now() - start).count());
+            total += seconds.back();
+        }
+
+        std::sort(seconds.begin(), seconds.end());
+        const double median = seconds[seconds.size() / 2];
+        printf("%-40s %6zu %12.3f %12.3f %14.0f\n",
+               (std::string(suite_) + "/" + label).c_str(),
+               seconds.size(),
+               median * 1e3,
+               seconds.front() * 1e3,
+               items / median);
+        fflush(stdout);
+    }
+
+    int run(int argc, char ** argv)
+    {
+        std::string repo_dir = "git2cpp-bench-repo";
+        Shape shape;
+        double min_seconds = 1;
+        bool pool_allocator = false;
+        const char * filter = "";
+        const char * trace_path = nullptr;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const char * a = argv[i];
+            if (auto v = option(a, "--repo-dir="))
+                repo_dir = v;
+            else if (auto v = option(a, "--files="))
+                shape.files = std::strtoul(v, nullptr, 10);
+            else if (auto v = option(a, "--commits="))
+                shape.commits = std::strtoul(v, nullptr, 10);
+            else if (auto v = option(a, "--refs="))
+                shape.refs = std::strtoul(v, nullptr, 10);
+            else if (auto v = option(a, "--min-time="))
+                min_seconds = std::strtod(v, nullptr);
+            else if (auto v = option(a, "--allocator="))
+            {
+                if (std::strcmp(v, "pool") != 0 && std::strcmp(v, "default") != 0)
+                {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                pool_allocator = std::strcmp(v, "pool") == 0;
+            }
+            else if (auto v = option(a, "--trace="))
+                trace_path = v;
+            else if (a[0] != '-')
+                filter = a;
+            else
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::pmr::synchronized_pool_resource pool;
+        std::optional<git::PmrInitializer> pmr_initializer;
+        std::optional<git::Initializer> initializer;
+        if (pool_allocator)
+            pmr_initializer.emplace(pool);
+        else
+            initializer.emplace();
+
+        try
+        {
+            if (ensure_repo(repo_dir, shape))
+                printf("generated %s\n", repo_dir.c_str());
+
+            if (trace_path)
+                git::metrics::start_trace();
+
+            printf("%-40s %6s %12s %12s %14s\n", "benchmark", "runs", "median ms", "min ms", "items/s");
+            for (auto const & b : registry())
+            {
+                if (!std::strstr(b.name, filter))
+                    continue;
+                Context ctx(repo_dir, shape, min_seconds, b.name);
+                b.fn(ctx);
+            }
+
+            if (trace_path)
+            {
+                std::ofstream trace(trace_path);
+                git::metrics::stop_trace(trace);
+            }
+        }
+        catch (std::exception const & e)
+        {
+            fprintf(stderr, "error: %s\n", e.what());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    return bench::run(argc, argv);
+}
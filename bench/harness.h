@@ -0,0 +1,45 @@
+#pragma once
+
+#include "synthetic_repo.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace bench
+{
+    struct Context
+    {
+        /// Working directory of the generated repository
+        std::string const & repo_path() const { return repo_path_; }
+        Shape const & shape() const { return shape_; }
+
+        /// Times `body` repeatedly and prints one result line
+        /// @param items units of work done by one run of `body`, used for the throughput column
+        void measure(const char * label, size_t items, std::function<void()> const & body);
+
+    private:
+        friend int run(int argc, char ** argv);
+        Context(std::string repo_path, Shape const & shape, double min_seconds, const char * suite);
+
+    private:
+        std::string repo_path_;
+        Shape shape_;
+        double min_seconds_;
+        const char * suite_;
+    };
+
+    typedef void (*benchmark_t)(Context &);
+
+    struct Registrar
+    {
+        Registrar(const char * name, benchmark_t);
+    };
+
+    int run(int argc, char ** argv);
+}
+
+#define GIT2CPP_BENCHMARK(name)                                   \
+    static void name(::bench::Context &);                         \
+    static const ::bench::Registrar name##_registrar(#name, name); \
+    static void name(::bench::Context & ctx)
@@ -0,0 +1,146 @@
+#include "harness.h"
+
+#include "git2cpp/repo.h"
+
+#include <git2/blame.h>
+#include <git2/diff.h>
+
+#include <algorithm>
+#include <string>
+
+namespace
+{
+    git_oid head_id(git::Repository const & repo)
+    {
+        return repo.head().target();
+    }
+}
+
+GIT2CPP_BENCHMARK(revwalk)
+{
+    git::Repository repo(ctx.repo_path());
+    const size_t commits = ctx.shape().commits + 1;
+
+    ctx.measure("ids", commits, [&] {
+        auto walker = repo.rev_walker();
+        walker.push_head();
+        char id[GIT_OID_HEXSZ];
+        while (walker.next(id))
+        {
+        }
+    });
+
+    ctx.measure("commits", commits, [&] {
+        auto walker = repo.rev_walker();
+        walker.sort(git::revwalker::sorting::topological);
+        walker.push_head();
+        while (auto commit = walker.next())
+        {
+        }
+    });
+
+    // without libgit2's cache of parsed commits, which makes repeated full lookups cheap
+    ctx.measure("commits_cold", commits, [&] {
+        git::Repository cold(ctx.repo_path());
+        auto walker = cold.rev_walker();
+        walker.push_head();
+        while (auto commit = walker.next())
+            commit.parents_num();
+    });
+
+    ctx.measure("views_cold", commits, [&] {
+        git::Repository cold(ctx.repo_path());
+        auto walker = cold.rev_walker();
+        walker.push_head();
+        while (auto commit = walker.next_view())
+            commit.parents_num();
+    });
+}
+
+GIT2CPP_BENCHMARK(diff)
+{
+    git::Repository repo(ctx.repo_path());
+    auto head = repo.commit_lookup(head_id(repo));
+    auto initial = repo.commit_lookup(head.id());
+    while (initial.parents_num())
+        initial = initial.parent(0);
+
+    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    auto old_tree = initial.tree();
+    auto new_tree = head.tree();
+    ctx.measure("initial_to_head", 1, [&] {
+        repo.diff(old_tree, new_tree, opts);
+    });
+
+    // unchanged subtrees are skipped by id, so this is dominated by tree loading
+    auto empty = repo.tree_builder().write();
+    ctx.measure("empty_to_head", ctx.shape().files, [&] {
+        repo.diff(empty, new_tree, opts);
+    });
+}
+
+GIT2CPP_BENCHMARK(blame)
+{
+    git::Repository repo(ctx.repo_path());
+    git_blame_options opts = GIT_BLAME_OPTIONS_INIT;
+    ctx.measure("file", ctx.shape().commits + 1, [&] {
+        repo.blame_file(bench::blame_path, opts);
+    });
+}
+
+// allocation heavy: compare runs with --allocator=default and --allocator=pool
+GIT2CPP_BENCHMARK(walk_and_diff)
+{
+    git::Repository repo(ctx.repo_path());
+    const size_t commits = std::min<size_t>(ctx.shape().commits, 200);
+    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+
+    ctx.measure("first_parent", commits, [&] {
+        auto walker = repo.rev_walker();
+        walker.simplify_first_parent();
+        walker.push_head();
+        for (size_t i = 0; i != commits; ++i)
+        {
+            auto commit = walker.next();
+            if (!commit || !commit.parents_num())
+                break;
+            auto tree = commit.tree();
+            auto parent_tree = commit.parent(0).tree();
+            auto diff = repo.diff(parent_tree, tree, opts);
+            diff.stats();
+        }
+    });
+}
+
+GIT2CPP_BENCHMARK(log_path)
+{
+    git::Repository repo(ctx.repo_path());
+    const size_t commits = ctx.shape().commits + 1;
+    const std::string dir = bench::file_path(0).substr(0, bench::file_path(0).rfind('/'));
+
+    ctx.measure("walker", commits, [&] {
+        auto walker = repo.rev_walker();
+        walker.push_head();
+        walker.push_path(dir);
+        while (walker.next_view())
+        {
+        }
+    });
+
+    // what examples/log.cpp did before: one pathspec-limited diff per commit
+    char * paths[] = {const_cast<char *>(dir.c_str())};
+    git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+    opts.pathspec = {paths, 1};
+    ctx.measure("diff_per_commit", commits, [&] {
+        auto walker = repo.rev_walker();
+        walker.push_head();
+        while (auto commit = walker.next())
+        {
+            if (commit.parents_num() != 1)
+                continue;
+            auto tree = commit.tree();
+            auto parent_tree = commit.parent(0).tree();
+            repo.diff(parent_tree, tree, opts).deltas_num();
+        }
+    });
+}
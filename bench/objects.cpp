@@ -0,0 +1,48 @@
+#include "harness.h"
+
+#include "git2cpp/repo.h"
+
+#include <vector>
+
+namespace
+{
+    std::vector<git_oid> sample_blobs(git::Repository const & repo, size_t max)
+    {
+        std::vector<git_oid> res;
+        repo.commit_lookup(repo.head().target()).tree().walk([&](const char *, git::Tree::BorrowedEntry const & entry) {
+            if (entry.type() == GIT_OBJECT_BLOB)
+                res.push_back(entry.id());
+            return res.size() < max;
+        });
+        return res;
+    }
+}
+
+GIT2CPP_BENCHMARK(odb)
+{
+    git::Repository repo(ctx.repo_path());
+    const auto blobs = sample_blobs(repo, 10000);
+    auto odb = repo.odb();
+
+    ctx.measure("read", blobs.size(), [&] {
+        for (auto const & id : blobs)
+            odb.read(id);
+    });
+}
+
+GIT2CPP_BENCHMARK(lookup)
+{
+    git::Repository repo(ctx.repo_path());
+    const auto blobs = sample_blobs(repo, 10000);
+
+    ctx.measure("blobs", blobs.size(), [&] {
+        for (auto const & id : blobs)
+            repo.blob_lookup(id);
+    });
+
+    repo.enable_object_cache(git::ObjectCache::Budget());
+    ctx.measure("blobs_cached", blobs.size(), [&] {
+        for (auto const & id : blobs)
+            repo.blob_lookup(id);
+    });
+}
@@ -0,0 +1,127 @@
+#include "harness.h"
+#include "synthetic_repo.h"
+
+#include "git2cpp/repo.h"
+#include "git2cpp/repository_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::vector<std::string> tag_names(size_t count)
+    {
+        std::vector<std::string> res;
+        for (size_t i = 0; i != count; ++i)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "refs/tags/bench-%06zu", i);
+            res.push_back(name);
+        }
+        return res;
+    }
+
+    void measure_refs(bench::Context & ctx, git::Repository & repo)
+    {
+        const auto names = tag_names(std::min<size_t>(ctx.shape().refs, 1000));
+
+        ctx.measure("lookup", names.size(), [&] {
+            for (auto const & name : names)
+                repo.ref(name.c_str());
+        });
+
+        ctx.measure("snapshot_lookup", names.size(), [&] {
+            auto snapshot = repo.ref_snapshot();
+            for (auto const & name : names)
+                snapshot.find(name);
+        });
+
+        ctx.measure("list", ctx.shape().refs, [&] {
+            repo.reference_list();
+        });
+
+        // moves the tags to HEAD and back, so that the repository is unchanged afterwards
+        const auto updated = tag_names(std::min<size_t>(ctx.shape().refs, 100));
+        std::vector<git_oid> original;
+        for (auto const & name : updated)
+            original.push_back(repo.ref(name.c_str()).target());
+        const git_oid head = repo.head().target();
+        ctx.measure("transaction", 2 * updated.size(), [&] {
+            for (bool forth : {true, false})
+            {
+                auto tx = repo.ref_transaction();
+                for (size_t i = 0; i != updated.size(); ++i)
+                    tx.update(updated[i], forth ? head : original[i], forth ? original[i] : head);
+                tx.commit();
+            }
+        });
+    }
+}
+
+GIT2CPP_BENCHMARK(refs)
+{
+    git::Repository repo(ctx.repo_path());
+    measure_refs(ctx, repo);
+}
+
+// the same refs in a reftable: a bare repository next to the generated one that borrows its objects
+GIT2CPP_BENCHMARK(reftable)
+{
+    namespace fs = std::filesystem;
+    const fs::path dir = ctx.repo_path() + "-reftable.git";
+    fs::remove_all(dir);
+    {
+        git::Repository source(ctx.repo_path());
+        const fs::path commondir = source.commondir();
+
+        git_repository_init_options opts = GIT_REPOSITORY_INIT_OPTIONS_INIT;
+        opts.flags = GIT_REPOSITORY_INIT_BARE | GIT_REPOSITORY_INIT_MKPATH;
+        git::Repository(dir.c_str(), git::Repository::init, opts);
+
+        std::ofstream(dir / "objects" / "info" / "alternates") << (commondir / "objects").string() << "\n";
+        fs::copy(commondir / "refs", dir / "refs", fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+        for (const char * file : {"HEAD", "packed-refs"})
+            if (fs::exists(commondir / file))
+                fs::copy_file(commondir / file, dir / file, fs::copy_options::overwrite_existing);
+    }
+
+    git::Repository repo(dir.c_str());
+    if (repo.convert_refs_to_reftable())
+        throw std::runtime_error("cannot convert the refs of " + dir.string());
+    measure_refs(ctx, repo);
+}
+
+GIT2CPP_BENCHMARK(open)
+{
+    namespace fs = std::filesystem;
+    const std::string gitdir = (fs::path(ctx.repo_path()) / ".git").string();
+    const std::string nested = (fs::path(ctx.repo_path()) / bench::file_path(0)).parent_path().string();
+    const std::string ceiling = fs::absolute(ctx.repo_path()).parent_path().string();
+
+    ctx.measure("repository", 1, [&] {
+        git::Repository repo(ctx.repo_path());
+    });
+
+    ctx.measure("repository_no_search", 1, [&] {
+        git::Repository repo(gitdir.c_str(), git::repository_open::no_search | git::repository_open::no_dotgit);
+    });
+
+    // discovery from a directory two levels below the workdir, unbounded and stopping at the repository
+    ctx.measure("repository_nested", 1, [&] {
+        git::Repository repo(nested.c_str(), git::repository_open::none);
+    });
+
+    ctx.measure("repository_nested_ceiling", 1, [&] {
+        git::Repository repo(nested.c_str(), git::repository_open::none, ceiling.c_str());
+    });
+
+    git::RepositoryPool pool;
+    ctx.measure("pool", 1, [&] {
+        pool.acquire(ctx.repo_path());
+    });
+}
@@ -0,0 +1,173 @@
+#include "synthetic_repo.h"
+
+#include "git2cpp/repo.h"
+
+#include <git2/checkout.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace bench
+{
+    const char * const blame_path = "blame.txt";
+
+    namespace
+    {
+        const size_t blame_lines = 200;
+        const size_t edits_per_commit = 4;
+        const git_time_t epoch = 1600000000;
+
+        // xorshift64*, so that the content does not depend on the standard library
+        struct Random
+        {
+            explicit Random(uint64_t seed)
+                : state_(seed ? seed : 1)
+            {}
+
+            uint64_t operator()()
+            {
+                state_ ^= state_ >> 12;
+                state_ ^= state_ << 25;
+                state_ ^= state_ >> 27;
+                return state_ * 0x2545F4914F6CDD1DULL;
+            }
+
+            size_t below(size_t n) { return static_cast<size_t>((*this)() % n); }
+
+        private:
+            uint64_t state_;
+        };
+
+        std::string text(Random & random, size_t size)
+        {
+            std::string res;
+            res.reserve(size + 16);
+            while (res.size() < size)
+            {
+                const size_t word = 2 + random.below(8);
+                for (size_t i = 0; i != word; ++i)
+                    res += static_cast<char>('a' + random.below(26));
+                res += random.below(8) ? ' ' : '\n';
+            }
+            res.back() = '\n';
+            return res;
+        }
+
+        std::string join(std::vector<std::string> const & lines)
+        {
+            std::string res;
+            for (auto const & line : lines)
+                res += line;
+            return res;
+        }
+
+        std::string describe(Shape const & shape)
+        {
+            std::ostringstream res;
+            res << shape.files << ' ' << shape.commits << ' ' << shape.refs << ' '
+                << shape.file_size << ' ' << shape.seed << '\n';
+            return res.str();
+        }
+
+        std::filesystem::path marker(std::string const & dir)
+        {
+            return std::filesystem::path(dir) / ".git" / "git2cpp-bench";
+        }
+
+        void generate(std::string const & dir, Shape const & shape)
+        {
+            std::filesystem::remove_all(dir);
+            git::Repository repo(dir, git::Repository::init);
+            Random random(shape.seed);
+
+            // the initial tree goes into one pack, as in a cloned repository
+            auto builder = repo.tree_builder();
+            {
+                auto odb = repo.odb();
+                auto writer = odb.bulk_writer();
+                for (size_t i = 0; i != shape.files; ++i)
+                {
+                    const std::string content = text(random, shape.file_size);
+                    builder.upsert(file_path(i), writer.write(content.data(), content.size(), GIT_OBJECT_BLOB));
+                }
+                writer.commit();
+            }
+
+            std::vector<std::string> blame(blame_lines);
+            for (auto & line : blame)
+                line = text(random, 40);
+            {
+                const std::string content = join(blame);
+                builder.upsert(blame_path, content.data(), content.size());
+            }
+
+            std::vector<git_oid> history;
+            history.reserve(shape.commits + 1);
+            {
+                git::Signature sig("bench", "bench@example.com", epoch, 0);
+                history.push_back(repo.create_commit("HEAD", sig, sig, "initial", builder.write()));
+            }
+
+            // history commits change a few files each and are stored loose
+            for (size_t c = 1; c <= shape.commits; ++c)
+            {
+                for (size_t e = 0; e != edits_per_commit && shape.files; ++e)
+                {
+                    const std::string content = text(random, shape.file_size);
+                    builder.upsert(file_path(random.below(shape.files)), content.data(), content.size());
+                }
+                blame[random.below(blame_lines)] = text(random, 40);
+                const std::string content = join(blame);
+                builder.upsert(blame_path, content.data(), content.size());
+
+                char message[32];
+                snprintf(message, sizeof(message), "commit %zu", c);
+                git::Signature sig("bench", "bench@example.com", epoch + git_time_t(c) * 60, 0);
+                auto parent = repo.commit_lookup(history.back());
+                history.push_back(repo.create_commit("HEAD", sig, sig, message, builder.write(), parent));
+            }
+
+            auto tx = repo.ref_transaction();
+            for (size_t i = 0; i != shape.refs; ++i)
+            {
+                char name[64];
+                snprintf(name, sizeof(name), "refs/tags/bench-%06zu", i);
+                tx.create(name, history[i % history.size()]);
+            }
+            if (!tx.commit().empty() || repo.compress_refs() < 0)
+                throw std::runtime_error("cannot create tags in " + dir);
+
+            git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
+            opts.checkout_strategy = GIT_CHECKOUT_FORCE;
+            if (repo.checkout_head(opts, std::max(1u, std::thread::hardware_concurrency())) < 0)
+                throw std::runtime_error("cannot check out " + dir);
+
+            std::ofstream(marker(dir)) << describe(shape);
+        }
+    }
+
+    std::string file_path(size_t i)
+    {
+        char res[48];
+        snprintf(res, sizeof(res), "d%03zu/e%zu/f%06zu.txt", i / 1000, (i / 100) % 10, i);
+        return res;
+    }
+
+    bool ensure_repo(std::string const & dir, Shape const & shape)
+    {
+        std::ifstream in(marker(dir));
+        std::stringstream existing;
+        existing << in.rdbuf();
+        if (in && existing.str() == describe(shape))
+            return false;
+
+        generate(dir, shape);
+        return true;
+    }
+}
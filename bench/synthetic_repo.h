@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bench
+{
+    /// Size of the generated repository. The same shape always gives the same objects.
+    struct Shape
+    {
+        size_t files = 100000;
+        size_t commits = 1000;
+        size_t refs = 10000;
+        size_t file_size = 256;
+        uint64_t seed = 42;
+    };
+
+    /// File that every commit of the history changes, for blame
+    extern const char * const blame_path;
+
+    /// Path of the i-th worktree file, 100 files per directory, two levels deep
+    std::string file_path(size_t i);
+
+    /// Generates a repository of the given shape in `dir` unless one is already there:
+    /// the worktree and its index, a linear history and `shape.refs` packed tags
+    /// @return true if it was generated
+    bool ensure_repo(std::string const & dir, Shape const & shape);
+}
@@ -0,0 +1,37 @@
+#include "harness.h"
+
+#include "git2cpp/repo.h"
+
+#include <string>
+
+GIT2CPP_BENCHMARK(status)
+{
+    git::Repository repo(ctx.repo_path());
+    ctx.measure("clean", ctx.shape().files, [&] {
+        repo.status(git::Status::Options());
+    });
+}
+
+GIT2CPP_BENCHMARK(index)
+{
+    git::Repository repo(ctx.repo_path());
+
+    const std::string index_path = std::string(repo.path()) + "index";
+    ctx.measure("read", ctx.shape().files, [&] {
+        git::Index index(index_path.c_str());
+    });
+
+    ctx.measure("view", ctx.shape().files, [&] {
+        repo.index_view();
+    });
+
+    // every file is hashed again since the in-memory index is emptied first;
+    // the index file itself is left untouched
+    char * all[] = {const_cast<char *>("*")};
+    const git_strarray pathspec = {all, 1};
+    ctx.measure("add_all", ctx.shape().files, [&] {
+        auto index = repo.index();
+        index.clear();
+        index.add_all(pathspec, nullptr);
+    });
+}
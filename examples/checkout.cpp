@@ -41,6 +41,7 @@
  *  --force: force the checkout to happen.
  *  --[no-]progress: show checkout progress, on by default.
  *  --perf: show performance data.
+ *  --jobs=<n>: write files with n threads.
  */
 
 namespace {
@@ -55,6 +56,7 @@ typedef struct {
 	int force : 1;
 	int progress : 1;
 	int perf : 1;
+	unsigned int jobs;
 } checkout_options;
 
 [[noreturn]] void print_usage()
@@ -64,7 +66,8 @@ typedef struct {
 		"  --git-dir: use the following git repository.\n"
 		"  --force: force the checkout.\n"
 		"  --[no-]progress: show checkout progress.\n"
-		"  --perf: show performance data.\n");
+		"  --perf: show performance data.\n"
+		"  --jobs=<n>: write files with n threads.\n");
 	exit(1);
 }
 
@@ -139,6 +142,7 @@ void parse_options(const char **repo_path, checkout_options *opts, struct args_i
 
 	for (args->pos = 1; args->pos < args->argc; ++args->pos) {
 		const char *curr = args->argv[args->pos];
+		const char *jobs;
 		int bool_arg;
 
 		if (strcmp(curr, "--") == 0) {
@@ -151,6 +155,8 @@ void parse_options(const char **repo_path, checkout_options *opts, struct args_i
 			opts->perf = bool_arg;
 		} else if (match_str_arg(repo_path, args, "--git-dir")) {
 			continue;
+		} else if (match_str_arg(&jobs, args, "--jobs")) {
+			opts->jobs = static_cast<unsigned int>(atoi(jobs));
 		} else {
 			break;
 		}
@@ -209,9 +215,10 @@ void perform_checkout_ref(git::Repository & repo, git::AnnotatedCommit const & t
 	 * Note that it's okay to pass a git_commit here, because it will be 
 	 * peeled to a tree.
 	 */
-	if (repo.checkout_tree(target_commit, checkout_opts))
+	if (repo.checkout_tree(target_commit, checkout_opts, opts.jobs))
         {
-                fprintf(stderr, "failed to checkout tree: %s\n", git_error_last()->message);
+                auto err = git_error_last();
+                fprintf(stderr, "failed to checkout tree: %s\n", err ? err->message : "unknown error");
 		return;
 	}
 
@@ -270,7 +277,7 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
-    if (strcmp("--", args.argv[args.pos]))
+    if (!strcmp("--", args.argv[args.pos]))
     {
 		/**
 		 * Try to checkout the given path
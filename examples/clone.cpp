@@ -5,6 +5,8 @@
 #include <git2/clone.h>
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 /* Define the printf format specifer to use for size_t output */
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -22,6 +24,7 @@ namespace
     struct progress_data
     {
         git_indexer_progress fetch_progress;
+        git::Remote::TransferRate rate;
         size_t completed_steps;
         size_t total_steps;
         const char * path;
@@ -39,15 +42,17 @@ namespace
             if (fetch_progress.total_objects &&
                 fetch_progress.received_objects == fetch_progress.total_objects)
             {
-                printf("Resolving deltas %u/%u\r",
+                printf("Resolving deltas %u/%u (%.0f/s)\r",
                        fetch_progress.indexed_deltas,
-                       fetch_progress.total_deltas);
+                       fetch_progress.total_deltas,
+                       rate.objects_per_second);
             }
             else
             {
-                printf("net %3d%% (%4" PRIuZ " kb, %5u/%5u)  /  idx %3d%% (%5u/%5u)  /  chk %3d%% (%4" PRIuZ "/%4" PRIuZ")%s\n",
+                printf("net %3d%% (%4" PRIuZ " kb, %5u/%5u, %6.0f kb/s)  /  idx %3d%% (%5u/%5u)  /  chk %3d%% (%4" PRIuZ "/%4" PRIuZ")%s\n",
                        network_percent, kbytes,
                        fetch_progress.received_objects, fetch_progress.total_objects,
+                       rate.bytes_per_second / 1024,
                        index_percent, fetch_progress.indexed_objects, fetch_progress.total_objects,
                        checkout_percent,
                        completed_steps, total_steps,
@@ -81,6 +86,11 @@ namespace
         void transfer_progress(git_indexer_progress const & progress) override
         {
             pd_.fetch_progress = progress;
+        }
+
+        void transfer_rate(git::Remote::TransferRate const & rate) override
+        {
+            pd_.rate = rate;
             pd_.print();
         }
 
@@ -97,9 +107,16 @@ namespace
 int main(int argc, char ** argv)
 {
     /* Validate args */
+    git::Remote::FetchOptions fetch_opts;
+    if (argc == 4 && !strncmp(argv[1], "--depth=", strlen("--depth=")))
+    {
+        fetch_opts.fetch_depth(atoi(argv[1] + strlen("--depth=")));
+        --argc;
+        ++argv;
+    }
     if (argc != 3)
     {
-        printf("USAGE: %s <url> <path>\n", argv[0]);
+        printf("USAGE: %s [--depth=<n>] <url> <path>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -116,7 +133,12 @@ int main(int argc, char ** argv)
     /* Do the clone */
     try
     {
-        git::Repository::clone(url, path, checkout_opts, fetch_callbacks);
+        git::Repository::clone(url, path, checkout_opts, fetch_callbacks, fetch_opts);
+    }
+    catch (git::fetch_depth_unsupported_error const & err)
+    {
+        printf("ERROR: %s\n", err.what());
+        return EXIT_FAILURE;
     }
     catch (git::repository_clone_error err)
     {
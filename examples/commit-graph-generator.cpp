@@ -12,7 +12,8 @@ namespace
             walker.sort(git::revwalker::sorting::topological);
             walker.simplify_first_parent();
 
-            while (git::Commit commit = walker.next())
+            // only ids, parents and the summary are needed, no full commit parsing
+            while (git::CommitView commit = walker.next_view())
             {
                 output_commit(commit);
 
@@ -26,7 +27,7 @@ namespace
                 {
                     auto branch_walker = repo_.rev_walker();
                     branch_walker.push(commit.parent_id(i));
-                    branch_walker.hide(commit.merge_base(0, i));
+                    branch_walker.hide(repo_.merge_base(commit.parent_id(0), commit.parent_id(i)));
                     (*this)(branch_walker);
                 }
             }
@@ -45,7 +46,7 @@ namespace
             return out_;
         }
 
-        void output_commit(git::Commit const & commit) const
+        void output_commit(git::CommitView const & commit) const
         {
             output_hash(commit.id()) << " [label=\"" << commit.summary() << "\"];"
                                      << "\n";
@@ -0,0 +1,67 @@
+#include "git2cpp/initializer.h"
+#include "git2cpp/repo.h"
+
+#include <git2/errors.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+namespace
+{
+    [[noreturn]] void usage(const char * message, const char * arg = nullptr)
+    {
+        if (message && arg)
+            fprintf(stderr, "%s: %s\n", message, arg);
+        else if (message)
+            fprintf(stderr, "%s\n", message);
+        fprintf(stderr, "usage: commit-graph write [--split] [--no-changed-paths] [--changed-paths-version=<1|2>] [<repo-dir>]\n");
+        exit(1);
+    }
+}
+
+// like `git commit-graph write --reachable --changed-paths`
+int main(int argc, char ** argv)
+{
+    if (argc < 2 || strcmp(argv[1], "write") != 0)
+        usage("no command specified");
+
+    git::CommitGraphOptions opts;
+    const char * dir = ".";
+    for (int i = 2; i < argc; ++i)
+    {
+        const char * a = argv[i];
+        if (!strcmp(a, "--split"))
+            opts.split = true;
+        else if (!strcmp(a, "--no-changed-paths"))
+            opts.changed_paths = false;
+        else if (!strcmp(a, "--changed-paths-version=1"))
+            opts.changed_paths_version = 1;
+        else if (!strcmp(a, "--changed-paths-version=2"))
+            opts.changed_paths_version = 2;
+        else if (a[0] == '-')
+            usage("Unsupported argument", a);
+        else
+            dir = a;
+    }
+
+    git::Initializer threads_initializer;
+
+    try
+    {
+        git::Repository repo(dir);
+        if (repo.write_commit_graph(opts))
+        {
+            auto err = git_error_last();
+            fprintf(stderr, "could not write the commit-graph: %s\n", err && err->message ? err->message : "unknown error");
+            return 1;
+        }
+        return 0;
+    }
+    catch (std::exception const & e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,91 @@
+#include "git2cpp/fetch_scheduler.h"
+#include "git2cpp/initializer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+
+namespace
+{
+    [[noreturn]] void usage(const char * message, const char * arg = nullptr)
+    {
+        if (message && arg)
+            fprintf(stderr, "%s: %s\n", message, arg);
+        else if (message)
+            fprintf(stderr, "%s\n", message);
+        fprintf(stderr, "usage: fetch [--jobs=<n>] [--per-host=<n>] [--only-changed] <repo-dir>...\n");
+        exit(1);
+    }
+
+    unsigned int parse_count(const char * arg, const char * value)
+    {
+        char * end;
+        const long n = strtol(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || n <= 0)
+            usage("Invalid count", arg);
+        return static_cast<unsigned int>(n);
+    }
+
+    // results arrive from the worker threads
+    struct Sink final : git::FetchScheduler::Sink
+    {
+        void finished(git::FetchScheduler::Result const & result) override
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            auto const & job = result.job;
+            if (!result.error.empty())
+                fprintf(stderr, "%s %s: %s\n", job.repo_path.c_str(), job.remote.c_str(), result.error.c_str());
+            else if (!result.stats.transferred)
+                printf("%s %s: up to date\n", job.repo_path.c_str(), job.remote.c_str());
+            else
+                printf("%s %s: fetched\n", job.repo_path.c_str(), job.remote.c_str());
+        }
+
+    private:
+        std::mutex mutex_;
+    };
+}
+
+// fetches all remotes of the given repositories at once, like `git fetch --multiple` across repositories
+int main(int argc, char ** argv)
+{
+    unsigned int jobs = 4;
+    unsigned int per_host = 4;
+    git::Remote::FetchOptions options;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i)
+    {
+        const char * a = argv[i];
+        if (!strncmp(a, "--jobs=", strlen("--jobs=")))
+            jobs = parse_count(a, a + strlen("--jobs="));
+        else if (!strncmp(a, "--per-host=", strlen("--per-host=")))
+            per_host = parse_count(a, a + strlen("--per-host="));
+        else if (!strcmp(a, "--only-changed"))
+            options.fetch_only_changed_refs();
+        else
+            usage("Unsupported argument", a);
+    }
+    if (i == argc)
+        usage("no repository specified");
+
+    git::Initializer threads_initializer;
+
+    try
+    {
+        git::FetchScheduler scheduler(jobs, per_host);
+        for (; i < argc; ++i)
+            scheduler.add_all(argv[i], options);
+
+        Sink sink;
+        return scheduler.run(sink) == 0 ? 0 : 1;
+    }
+    catch (std::exception const & e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "git2cpp/initializer.h"
+#include "git2cpp/repo.h"
+
+using namespace git;
+
+// symbolic refs are followed inside the snapshot, as far as git does
+static git_oid const * resolve(RefSnapshot const & refs, RefSnapshot::Ref const * ref)
+{
+    for (int depth = 0; ref && depth <= 5; ++depth)
+    {
+        if (ref->symbolic_target.empty())
+            return &ref->id;
+        ref = refs.find(ref->symbolic_target);
+    }
+    return nullptr;
+}
+
+// prints references like `git for-each-ref --format='%(objectname) %(refname)' [<prefix>]`
+int main(int argc, char ** argv)
+{
+    const char * dir = ".";
+    const char * prefix = nullptr;
+
+    Initializer threads_initializer;
+
+    if (argc > 1)
+        dir = argv[1];
+    if (argc > 2)
+        prefix = argv[2];
+    if (argc > 3)
+    {
+        fprintf(stderr, "usage: for-each-ref [<repo-dir> [<prefix>]]\n");
+        return 1;
+    }
+
+    Repository repo(dir);
+    auto refs = repo.ref_snapshot();
+
+    auto range = prefix ? refs.prefix_range(prefix) : std::make_pair(size_t(0), refs.size());
+    for (size_t i = range.first; i != range.second; ++i)
+    {
+        auto const & ref = refs[i];
+        auto id = resolve(refs, &ref);
+        if (!id)
+            continue;
+
+        char out[41];
+        out[40] = '\0';
+        git_oid_fmt(out, id);
+        printf("%s %.*s\n", out, static_cast<int>(ref.name.size()), ref.name.data());
+    }
+
+    return 0;
+}
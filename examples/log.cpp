@@ -221,9 +221,19 @@ static int match_with_parent(git::Commit const & commit, int i, git_diff_options
     return diff.deltas_num() > 0;
 }
 
+// pathspecs without wildcards or magic can be handed to the walker as paths
+static bool is_literal_path(const char * path)
+{
+    return *path && *path != ':' && strcmp(path, ".") != 0 && strncmp(path, "./", 2) != 0
+        && !strpbrk(path, "*?[\\");
+}
+
 struct log_options
 {
     int show_diff;
+    int ids_only;
+    int full_history;
+    int first_parent;
     int skip, limit;
     int min_parents, max_parents;
     git_time_t before;
@@ -294,6 +304,12 @@ int parse_options(int argc, char * argv[], log_state & s, log_options & opt, int
             /* found valid --min_parents */;
         else if (!strcmp(a, "-p") || !strcmp(a, "-u") || !strcmp(a, "--patch"))
             opt.show_diff = 1;
+        else if (!strcmp(a, "--format=%H"))
+            opt.ids_only = 1;
+        else if (!strcmp(a, "--full-history"))
+            opt.full_history = 1;
+        else if (!strcmp(a, "--first-parent"))
+            opt.first_parent = 1;
         else
             usage("Unsupported argument", a);
     }
@@ -323,6 +339,21 @@ int main(int argc, char * argv[])
     diffopts.pathspec.count = argc - parsed_options_num;
     git::Pathspec ps(diffopts.pathspec);
 
+    if (opt.first_parent)
+        s.walker->simplify_first_parent();
+
+    // plain paths are limited by the walker itself, which only compares trees along them
+    bool walker_limits_paths = diffopts.pathspec.count > 0;
+    for (size_t i = 0; i != diffopts.pathspec.count; ++i)
+        walker_limits_paths = walker_limits_paths && is_literal_path(diffopts.pathspec.strings[i]);
+    if (walker_limits_paths)
+    {
+        for (size_t i = 0; i != diffopts.pathspec.count; ++i)
+            s.walker->push_path(diffopts.pathspec.strings[i]);
+        if (opt.full_history)
+            s.walker->full_history();
+    }
+
     count = 0;
     int printed = 0;
 
@@ -334,7 +365,7 @@ int main(int argc, char * argv[])
         if (opt.max_parents > 0 && parents > opt.max_parents)
             continue;
 
-        if (diffopts.pathspec.count > 0)
+        if (diffopts.pathspec.count > 0 && !walker_limits_paths)
         {
             int unmatched = parents;
 
@@ -367,6 +398,12 @@ int main(int argc, char * argv[])
             break;
         }
 
+        if (opt.ids_only)
+        {
+            printf("%s\n", git::id_to_str(commit.id()).c_str());
+            continue;
+        }
+
         print_commit(commit);
 
         if (opt.show_diff)
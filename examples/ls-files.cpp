@@ -25,7 +25,7 @@
 
 #include <git2cpp/repo.h>
 #include <git2cpp/initializer.h>
-#include <git2cpp/index.h>
+#include <git2cpp/index_view.h>
 
 #include "git2/index.h"
 
@@ -82,7 +82,7 @@ static int parse_options(ls_options *opts, int argc, char *argv[])
 	return 0;
 }
 
-static int print_paths(ls_options *opts, git::Index & index)
+static int print_paths(ls_options *opts, git::IndexView const & index)
 {
 	/* if there are no files explicitly listed by the user print all entries in the index */
 	if (opts->file_count == 0) {
@@ -90,7 +90,7 @@ static int print_paths(ls_options *opts, git::Index & index)
 
 		for (size_t i = 0; i < entry_count; i++) {
 			auto entry = index[i];
-			puts(entry->path);
+			puts(entry.path);
 		}
 		return 0;
 	}
@@ -98,10 +98,22 @@ static int print_paths(ls_options *opts, git::Index & index)
 	/* loop through the files found in the args and print them if they exist */
 	for (size_t i = 0; i < opts->file_count; ++i) {
 		const char *path = opts->files[i];
+		size_t const path_len = strlen(path);
+
+		/* a directory given as "dir/" lists everything below it */
+		bool matched;
+		if (path_len > 0 && path[path_len - 1] == '/') {
+			auto const range = index.prefix_range(path);
+			for (size_t j = range.first; j < range.second; ++j)
+				puts(index[j].path);
+			matched = range.first != range.second;
+		} else {
+			matched = bool(index.get_by_path(path, GIT_INDEX_STAGE_NORMAL));
+			if (matched)
+				puts(path);
+		}
 
-		if (index.get_by_path(path, GIT_INDEX_STAGE_NORMAL)) {
-			puts(path);
-		} else if (opts->error_unmatch) {
+		if (!matched && opts->error_unmatch) {
 			fprintf(stderr, "error: pathspec '%s' did not match any file(s) known to git.\n", path);
 			fprintf(stderr, "Did you forget to 'git add'?\n");
 			return -1;
@@ -122,7 +134,7 @@ int main(int argc, char *argv[])
     auto_git_initializer;
 
     git::Repository repo(".");
-    auto index = repo.index();
+    auto index = repo.index_view();
 
     return print_paths(&opts, index);
 }
@@ -0,0 +1,38 @@
+#include "git2cpp/initializer.h"
+#include "git2cpp/repo.h"
+
+#include <git2/errors.h>
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+// like `git refs migrate --ref-format=reftable [<repo-dir>]`
+int main(int argc, char ** argv)
+{
+    if (argc < 3 || argc > 4 || strcmp(argv[1], "migrate") != 0 || strcmp(argv[2], "--ref-format=reftable") != 0)
+    {
+        fprintf(stderr, "usage: refs migrate --ref-format=reftable [<repo-dir>]\n");
+        return 1;
+    }
+    const char * dir = argc > 3 ? argv[3] : ".";
+
+    git::Initializer threads_initializer;
+
+    try
+    {
+        git::Repository repo(dir);
+        if (repo.convert_refs_to_reftable())
+        {
+            auto err = git_error_last();
+            fprintf(stderr, "could not migrate the refs: %s\n", err && err->message ? err->message : "unknown error");
+            return 1;
+        }
+        return 0;
+    }
+    catch (std::exception const & e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
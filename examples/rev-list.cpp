@@ -40,7 +40,7 @@ void push_range(Repository const & repo, RevWalker const & walk, const char * ra
     push_commit(walk, r.from.id(), hide);
 }
 
-void revwalk_parseopts(Repository const & repo, RevWalker & walk, int nopts, char ** opts)
+void revwalk_parseopts(Repository const & repo, RevWalker & walk, int nopts, char ** opts, bool & parents)
 {
     namespace sort = revwalker::sorting;
     auto sorting = sort::none;
@@ -64,6 +64,10 @@ void revwalk_parseopts(Repository const & repo, RevWalker & walk, int nopts, cha
                 sorting = sorting & ~sort::reverse;
             walk.sort(sorting);
         }
+        else if (!strcmp(opts[i], "--parents"))
+        {
+            parents = true;
+        }
         else if (!strcmp(opts[i], "--not"))
         {
             hide = !hide;
@@ -92,9 +96,28 @@ int main(int argc, char ** argv)
         Repository repo(".");
         auto walker = repo.rev_walker();
 
-        revwalk_parseopts(repo, walker, argc - 1, argv + 1);
+        bool parents = false;
+        revwalk_parseopts(repo, walker, argc - 1, argv + 1, parents);
 
         char buf[41];
+        buf[40] = '\0';
+
+        if (parents)
+        {
+            while (auto commit = walker.next_view())
+            {
+                git_oid_fmt(buf, &commit.id());
+                printf("%s", buf);
+                for (size_t i = 0; i != commit.parents_num(); ++i)
+                {
+                    const git_oid parent = commit.parent_id(i);
+                    git_oid_fmt(buf, &parent);
+                    printf(" %s", buf);
+                }
+                printf("\n");
+            }
+            return 0;
+        }
 
         while (walker.next(buf))
         {
@@ -25,12 +25,13 @@ struct parse_state
 {
     internal::optional<Repository> repo;
     const char * repodir = ".";
+    repository_open::flags open_flags = repository_open::none;
 };
 
 void parse_revision(parse_state & ps, const char * revstr)
 {
     if (!ps.repo)
-        internal::emplace(ps.repo, ps.repodir);
+        internal::emplace(ps.repo, ps.repodir, ps.open_flags);
 
     Revspec rs = ps.repo->revparse(revstr);
 
@@ -66,7 +67,11 @@ int main(int argc, char * argv[])
         if (a[0] != '-')
             parse_revision(ps, a);
         else if (!strncmp(a, "--git-dir=", strlen("--git-dir=")))
+        {
+            // like git, take an explicit --git-dir as is instead of searching upwards
             ps.repodir = a + strlen("--git-dir=");
+            ps.open_flags = repository_open::no_search | repository_open::no_dotgit;
+        }
         else
             usage("Cannot handle argument", a);
     }
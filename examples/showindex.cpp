@@ -11,43 +11,57 @@ using namespace git;
 int main(int argc, char ** argv)
 {
     const char * dir = ".";
+    // one line per entry, like `git ls-files -s`
+    bool stage_lines = false;
 
     Initializer threads_initalizer;
 
-    if (argc > 1)
-        dir = argv[1];
-    if (!dir || argc > 2)
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "-s") == 0)
     {
-        fprintf(stderr, "usage: showindex [<repo-dir>]\n");
+        stage_lines = true;
+        ++arg;
+    }
+    if (arg < argc)
+        dir = argv[arg++];
+    if (!dir || arg < argc)
+    {
+        fprintf(stderr, "usage: showindex [-s] [<repo-dir>]\n");
         return 1;
     }
 
     size_t dirlen = strlen(dir);
-    Index index = (dirlen > 5 && strcmp(dir + dirlen - 5, "index") == 0)
-                      ? Index(dir)
-                      : Repository(dir).index();
+    IndexView index = (dirlen > 5 && strcmp(dir + dirlen - 5, "index") == 0)
+                          ? IndexView(dir)
+                          : Repository(dir).index_view();
 
     size_t ecount = index.entrycount();
-    if (!ecount)
+    if (!ecount && !stage_lines)
         printf("Empty index\n");
 
     for (size_t i = 0; i < ecount; ++i)
     {
-        auto e = index[i];
+        auto const e = index[i];
 
         char out[41];
         out[40] = '\0';
-        git_oid_fmt(out, &e->id);
+        git_oid_fmt(out, &e.id);
+
+        if (stage_lines)
+        {
+            printf("%06o %s %d\t%s\n", e.mode, out, git_index_entry_stage(&e), e.path);
+            continue;
+        }
 
-        printf("File Path: %s\n", e->path);
-        printf("    Stage: %d\n", git_index_entry_stage(e));
+        printf("File Path: %s\n", e.path);
+        printf("    Stage: %d\n", git_index_entry_stage(&e));
         printf(" Blob SHA: %s\n", out);
-        printf("File Mode: %07o\n", e->mode);
-        printf("File Size: %d bytes\n", (int)e->file_size);
-        printf("Dev/Inode: %d/%d\n", (int)e->dev, (int)e->ino);
-        printf("  UID/GID: %d/%d\n", (int)e->uid, (int)e->gid);
-        printf("    ctime: %d\n", (int)e->ctime.seconds);
-        printf("    mtime: %d\n", (int)e->mtime.seconds);
+        printf("File Mode: %07o\n", e.mode);
+        printf("File Size: %d bytes\n", (int)e.file_size);
+        printf("Dev/Inode: %d/%d\n", (int)e.dev, (int)e.ino);
+        printf("  UID/GID: %d/%d\n", (int)e.uid, (int)e.gid);
+        printf("    ctime: %d\n", (int)e.ctime.seconds);
+        printf("    mtime: %d\n", (int)e.mtime.seconds);
         printf("\n");
     }
 
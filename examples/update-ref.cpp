@@ -0,0 +1,93 @@
+#include "git2cpp/initializer.h"
+#include "git2cpp/repo.h"
+
+#include <git2/errors.h>
+
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace git;
+
+namespace
+{
+    git_oid parse_id(std::string const & str)
+    {
+        git_oid id;
+        if (str.size() != GIT_OID_HEXSZ || git_oid_fromstr(&id, str.c_str()) != 0)
+            throw std::invalid_argument("invalid object id '" + str + "'");
+        return id;
+    }
+
+    const char * reason_str(RefTransaction::Conflict::Reason reason)
+    {
+        switch (reason)
+        {
+        case RefTransaction::Conflict::Reason::locked:
+            return "locked";
+        case RefTransaction::Conflict::Reason::already_exists:
+            return "already exists";
+        case RefTransaction::Conflict::Reason::unexpected_value:
+            return "unexpected value";
+        }
+        return "unknown";
+    }
+}
+
+// reads commands like `git update-ref --stdin`, except that the old value is required:
+//   create <ref> <new>
+//   update <ref> <new> <old>
+//   delete <ref> <old>
+// and applies them all or none
+int main(int argc, char ** argv)
+{
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: update-ref [<repo-dir>] < commands\n");
+        return 1;
+    }
+
+    Initializer threads_initializer;
+
+    try
+    {
+        Repository repo(argc > 1 ? argv[1] : ".");
+        auto transaction = repo.ref_transaction();
+
+        char line[1024];
+        while (fgets(line, sizeof(line), stdin))
+        {
+            std::istringstream command(line);
+            std::string verb, name, first, second, rest;
+            command >> verb >> name >> first >> second >> rest;
+            if (verb.empty())
+                continue;
+
+            if (verb == "create" && !first.empty() && second.empty())
+                transaction.create(name, parse_id(first));
+            else if (verb == "update" && !second.empty() && rest.empty())
+                transaction.update(name, parse_id(first), parse_id(second));
+            else if (verb == "delete" && !first.empty() && second.empty())
+                transaction.remove(name, parse_id(first));
+            else
+                throw std::invalid_argument("invalid command: " + std::string(line));
+        }
+
+        auto conflicts = transaction.commit();
+        for (auto const & conflict : conflicts)
+            fprintf(stderr, "%s: %s\n", conflict.name.c_str(), reason_str(conflict.reason));
+        return conflicts.empty() ? 0 : 1;
+    }
+    catch (std::exception const & e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        if (auto err = git_error_last())
+        {
+            if (err->message)
+                fprintf(stderr, "libgit2 last error: %s\n", err->message);
+        }
+        return 1;
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "repo.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include) && __has_include(<coroutine>)
+    #include <coroutine>
+    #define GIT2CPP_HAS_COROUTINES
+#endif
+
+namespace git
+{
+    /// Fixed pool of threads running the operations of any number of AsyncRepository objects
+    struct AsyncExecutor
+    {
+        explicit AsyncExecutor(unsigned int threads = std::thread::hardware_concurrency());
+        ~AsyncExecutor();
+
+        AsyncExecutor(AsyncExecutor const &) = delete;
+        AsyncExecutor & operator=(AsyncExecutor const &) = delete;
+
+        void post(std::function<void ()>);
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<std::function<void ()>> tasks_;
+        bool stop_ = false;
+        std::vector<std::thread> threads_;
+    };
+
+    struct AsyncRepository;
+
+    namespace internal
+    {
+        /// Lets a coroutine wait for an operation without blocking a thread
+        struct AsyncCompletion
+        {
+            explicit AsyncCompletion(AsyncRepository & repo)
+                : repo_(repo)
+            {}
+
+            /// Called after the result is stored; dispatches the waiting continuation, if any
+            void finish();
+            /// @return false if the operation already finished, otherwise
+            /// the continuation is dispatched when it does
+            bool then(std::function<void ()> continuation);
+
+        private:
+            AsyncRepository & repo_;
+            std::mutex mutex_;
+            bool finished_ = false;
+            std::function<void ()> continuation_;
+        };
+    }
+
+    /// Result of an AsyncRepository operation; a coroutine can `co_await` it instead of blocking in get()
+    template <class T>
+    struct AsyncFuture : std::future<T>
+    {
+        AsyncFuture() = default;
+
+        AsyncFuture(std::future<T> future, std::shared_ptr<internal::AsyncCompletion> completion)
+            : std::future<T>(std::move(future))
+            , completion_(std::move(completion))
+        {}
+
+        internal::AsyncCompletion & completion() const { return *completion_; }
+
+    private:
+        std::shared_ptr<internal::AsyncCompletion> completion_;
+    };
+
+    /// Runs operations on a Repository on an AsyncExecutor, one at a time and in
+    /// submission order, so the underlying git_repository is never used concurrently.
+    /// Objects in the results refer to the wrapped repository: read them freely,
+    /// but pass further repository work through submit().
+    struct AsyncRepository
+    {
+        AsyncRepository(AsyncExecutor &, Repository);
+        /// Waits for the submitted operations to finish
+        ~AsyncRepository();
+
+        AsyncRepository(AsyncRepository const &) = delete;
+        AsyncRepository & operator=(AsyncRepository const &) = delete;
+
+        /// Runs f(Repository &) after all previously submitted operations
+        template <class F>
+        auto submit(F f) -> AsyncFuture<std::invoke_result_t<F, Repository &>>
+        {
+            typedef std::invoke_result_t<F, Repository &> result_t;
+            auto task = std::make_shared<std::packaged_task<result_t (Repository &)>>(std::move(f));
+            auto completion = std::make_shared<internal::AsyncCompletion>(*this);
+            AsyncFuture<result_t> res(task->get_future(), completion);
+            enqueue([task, completion] (Repository & repo)
+            {
+                (*task)(repo);
+                completion->finish();
+            });
+            return res;
+        }
+
+        AsyncFuture<Commit> commit_lookup(git_oid const &);
+        AsyncFuture<Tree> tree_lookup(git_oid const &);
+        AsyncFuture<Blob> blob_lookup(git_oid const &);
+        AsyncFuture<Diff> diff(git_oid const & old_tree, git_oid const & new_tree, git_diff_options const &);
+        AsyncFuture<Status> status(Status::Options const &);
+        AsyncFuture<Blame> blame_file(std::string path, git_blame_options const &);
+        /// Callbacks are invoked on an executor thread
+        AsyncFuture<Remote::FetchStats> fetch(std::string remote, Remote::FetchCallbacks &, Remote::FetchOptions const & = {});
+
+        /// Dispatches continuations of awaiting coroutines, e.g. to an event loop. It is called
+        /// on an executor thread after the operation finished, never inside the serial queue.
+        /// By default the continuation runs right there. Set it before awaiting anything.
+        void set_resumer(std::function<void (std::function<void ()> continuation)> resumer) { resumer_ = std::move(resumer); }
+
+#ifdef GIT2CPP_HAS_COROUTINES
+        /// `co_await repo.async([](Repository & r) { ... })`
+        template <class F>
+        auto async(F f) -> AsyncFuture<std::invoke_result_t<F, Repository &>>
+        {
+            return submit(std::move(f));
+        }
+#endif
+
+    private:
+        friend struct internal::AsyncCompletion;
+
+        void enqueue(std::function<void (Repository &)>);
+        void drain();
+        void resume(std::function<void ()> continuation);
+
+    private:
+        AsyncExecutor & executor_;
+        Repository repo_;
+
+        std::mutex mutex_;
+        std::condition_variable idle_;
+        std::deque<std::function<void (Repository &)>> queue_;
+        bool running_ = false;
+
+        std::function<void (std::function<void ()>)> resumer_;
+    };
+
+#ifdef GIT2CPP_HAS_COROUTINES
+    /// `co_await repo.diff(...)`: suspends until the operation finished, then continues through the resumer
+    template <class T>
+    auto operator co_await(AsyncFuture<T> && future)
+    {
+        struct Awaiter
+        {
+            AsyncFuture<T> future;
+
+            bool await_ready() const { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+            bool await_suspend(std::coroutine_handle<> h) { return future.completion().then([h] { h.resume(); }); }
+            T await_resume() { return future.get(); }
+        };
+        return Awaiter{std::move(future)};
+    }
+#endif
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <git2/oid.h>
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace git
+{
+    namespace internal
+    {
+        struct FileMapping;
+    }
+
+    /// Changed-path Bloom filters of the commit-graph, as written by
+    /// `git commit-graph write --changed-paths`, from a single file or a split chain.
+    /// Each filter tells which paths a commit changed compared to its first parent.
+    struct ChangedPathFilters
+    {
+        /// Hashes of a path and of all its leading directories, computed once per query path
+        struct Path
+        {
+            explicit Path(std::string_view path);
+
+        private:
+            friend struct ChangedPathFilters;
+
+            struct Key
+            {
+                // indexed by hash version - 1
+                uint32_t hash0[2];
+                uint32_t hash1[2];
+            };
+            std::vector<Key> keys_;
+        };
+
+        enum class Answer
+        {
+            no,         ///< the path is certainly unchanged
+            maybe,
+            unknown     ///< no filter for this commit, or its filter is too large
+        };
+
+        /// @param objects_dir e.g. ".git/objects"; missing or unreadable files give no filters
+        explicit ChangedPathFilters(const char * objects_dir);
+        /// No filters at all
+        ChangedPathFilters() = default;
+
+        /// Commits with a filter
+        size_t size() const;
+
+        Answer maybe_changed(git_oid const & commit, Path const &) const;
+
+    private:
+        struct Layer
+        {
+            std::unique_ptr<internal::FileMapping> file;
+            unsigned char const * fanout = nullptr;
+            unsigned char const * oids = nullptr;
+            unsigned char const * index = nullptr;
+            unsigned char const * filters = nullptr;
+            size_t filters_size = 0;
+            uint32_t commits = 0;
+            uint32_t hash_version = 0;
+            uint32_t num_hashes = 0;
+        };
+
+        static bool load(Layer &, const char * path);
+
+    private:
+        struct Destroy { void operator() (Layer *) const; };
+        std::vector<std::unique_ptr<Layer, Destroy>> layers_;
+    };
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace git
+{
+    /// How Repository::write_commit_graph() writes the commit-graph
+    struct CommitGraphOptions
+    {
+        /// Store changed-path Bloom filters, like `--changed-paths`
+        bool changed_paths = true;
+        /// Hash version of the filters: version 1 is read by every git with filter support,
+        /// version 2 hashes non-ASCII paths as specified and needs git 2.46 or newer.
+        /// A new layer of a chain keeps the version of the layers below it.
+        uint32_t changed_paths_version = 1;
+        /// Add a layer to `objects/info/commit-graphs` instead of rewriting
+        /// `objects/info/commit-graph`, like `--split`
+        bool split = false;
+    };
+}
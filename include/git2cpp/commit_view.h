@@ -0,0 +1,77 @@
+#pragma once
+
+#include <git2/oid.h>
+#include <git2/types.h>
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+struct git_odb_object;
+struct git_repository;
+
+namespace git
+{
+    /// Commits of a shallow repository whose parents are cut off, from its `shallow` file
+    struct ShallowGrafts
+    {
+        std::vector<git_oid> ids;   ///< sorted
+
+        bool contains(git_oid const &) const;
+    };
+
+    /// Read-only commit working directly on the raw object.
+    /// Construction only checks the tree and parent lines; the rest of the header
+    /// and the message are located on first access, and nothing is copied.
+    /// Not safe for concurrent use, even through const methods.
+    struct CommitView
+    {
+        struct Person
+        {
+            std::string_view name;
+            std::string_view email;
+            git_time_t time;
+            int offset;     ///< minutes from UTC
+        };
+
+        explicit operator bool() const { return obj_ != nullptr; }
+
+        git_oid const & id() const { return id_; }
+        git_oid tree_id() const;
+
+        /// With shallow grafts applied, same as Commit::parents_num
+        size_t parents_num() const { return parents_num_; }
+        git_oid parent_id(size_t i) const;
+
+        Person author() const;
+        Person commiter() const;
+        /// Commit time, same as Commit::time
+        git_time_t time() const;
+
+        /// Raw message, not NUL-terminated
+        std::string_view message() const;
+        /// First non-empty line of the message; unlike Commit::summary,
+        /// further lines of the first paragraph are not appended
+        std::string_view summary() const;
+
+        CommitView() = default;
+
+    private:
+        friend struct Repository;
+        CommitView(git_repository *, git_oid const &, ShallowGrafts const &);
+
+        void scan() const;
+        std::string_view data() const;
+
+    private:
+        struct Destroy { void operator() (git_odb_object *) const; };
+        std::unique_ptr<git_odb_object, Destroy> obj_;
+        git_oid id_;
+        size_t parents_num_ = 0;
+        size_t parents_end_ = 0;   ///< offset past the raw parent lines
+
+        // offsets into the raw object, found by scan()
+        mutable bool scanned_ = false;
+        mutable size_t author_ = 0, commiter_ = 0, message_ = 0;
+    };
+}
@@ -43,6 +43,20 @@ namespace git
         {}
     };
 
+    struct refs_read_error : error_t
+    {
+        explicit refs_read_error(std::string const & file)
+            : error_t("Could not read references from " + file)
+        {}
+    };
+
+    struct ref_transaction_error : error_t
+    {
+        ref_transaction_error()
+            : error_t("Could not update references")
+        {}
+    };
+
     struct commit_lookup_error : error_t
     {
         explicit commit_lookup_error(git_oid const & id)
@@ -57,6 +71,13 @@ namespace git
         {}
     };
 
+    struct tree_create_error : error_t
+    {
+        tree_create_error()
+            : error_t("Could not create tree")
+        {}
+    };
+
     struct tag_lookup_error : error_t
     {
         explicit tag_lookup_error(git_oid const & id)
@@ -113,6 +134,13 @@ namespace git
         {}
     };
 
+    struct fetch_depth_unsupported_error : error_t
+    {
+        fetch_depth_unsupported_error()
+            : error_t("Shallow fetch requires libgit2 1.7 or newer")
+        {}
+    };
+
     struct commit_parent_error : error_t
     {
         explicit commit_parent_error(git_oid const & id)
@@ -183,6 +211,13 @@ namespace git
         {}
     };
 
+    struct revwalk_started_error : error_t
+    {
+        revwalk_started_error()
+            : error_t("Could not limit the paths of a walk that already started")
+        {}
+    };
+
     struct invalid_head_error : error_t
     {
         invalid_head_error()
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "remote.h"
+
+#include <string>
+#include <vector>
+
+namespace git
+{
+    /// Fetches remotes of one or many repositories on a bounded pool of threads.
+    /// Every job opens its own Repository, so jobs never share libgit2 handles.
+    struct FetchScheduler
+    {
+        struct Job
+        {
+            std::string repo_path;
+            std::string remote;
+            std::string host;           ///< connection limit key, taken from the remote url;
+                                        ///< empty for local and file:// remotes, which are not limited
+            Remote::FetchOptions options;
+        };
+
+        struct Result
+        {
+            Job const & job;
+            Remote::FetchStats stats;
+            std::string error;          ///< empty on success
+        };
+
+        /// Shared progress and metrics sink; its methods are called from worker threads concurrently
+        struct Sink
+        {
+        protected:
+            ~Sink() = default;
+
+        public:
+            virtual void started(Job const &) {}
+            virtual void sideband_progress(Job const &, char const * str, int len) {}
+            virtual void transfer_rate(Job const &, Remote::TransferRate const &) {}
+            virtual void finished(Result const &) {}
+
+            virtual git_credential* acquire_cred(Job const &, const char * url, const char * username_from_url, unsigned int allowed_types)
+            {
+                return nullptr;
+            }
+        };
+
+        /// @param workers number of fetches in flight at once
+        /// @param per_host number of fetches in flight against one network host
+        explicit FetchScheduler(unsigned int workers, unsigned int per_host = 4);
+
+        /// Looks up the remote to find its host; throws if the repository or the remote can't be opened
+        void add(std::string repo_path, std::string remote, Remote::FetchOptions options = {});
+        /// Adds every remote of the repository
+        void add_all(std::string const & repo_path, Remote::FetchOptions options = {});
+
+        size_t size() const { return jobs_.size(); }
+
+        /// Runs all added jobs and blocks until they are done.
+        /// If Sink::finished throws, no further job is started and the first such exception
+        /// is rethrown here once the jobs in flight are done; so is a failure to start a thread.
+        /// @return number of failed jobs
+        size_t run(Sink &);
+
+    private:
+        unsigned int workers_;
+        unsigned int per_host_;
+        std::vector<Job> jobs_;
+    };
+}
@@ -5,6 +5,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 
 struct git_index;
 struct git_repository;
@@ -23,6 +24,13 @@ namespace git
 
         git_index_entry const * get_by_path(const char *path, int stage) const;
 
+        /// Positions [first, last) of the entries whose path starts with `prefix`,
+        /// e.g. "src/lib/" for one directory of a sparse-checkout cone.
+        /// Found by binary search, so walking a cone costs O(log n + cone size)
+        /// instead of a scan over the whole index.
+        /// Only a query helper: the index is still read and written in full.
+        std::pair<size_t, size_t> prefix_range(const char * prefix) const;
+
         typedef std::function<int(const char * path, const char * mathched_pathspec)> matched_path_callback_t;
 
         void update_all(git_strarray const & pathspec, matched_path_callback_t cb);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "internal/optional.h"
+
+#include <git2/index.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace git
+{
+    namespace internal
+    {
+        struct FileMapping;
+    }
+
+    /// Read-only index backed by the memory-mapped index file.
+    /// Opening only records where each entry starts; entries are decoded on access.
+    /// Supports on-disk index versions 2, 3 and 4; extensions are skipped,
+    /// but a split index (`link` extension) throws index_open_error.
+    struct IndexView
+    {
+        explicit IndexView(const char * index_path);
+
+        size_t entrycount() const { return offsets_.size(); }
+
+        /// `path` of the result points into the view and lives as long as it
+        git_index_entry operator[](size_t i) const;
+
+        internal::optional<git_index_entry> get_by_path(const char * path, int stage) const;
+
+        /// same as Index::prefix_range
+        std::pair<size_t, size_t> prefix_range(const char * prefix) const;
+
+    private:
+        uint16_t flags(size_t i) const;
+        const char * path(size_t i) const;
+
+    private:
+        struct Destroy { void operator() (internal::FileMapping *) const; };
+        std::unique_ptr<internal::FileMapping, Destroy> file_;
+        unsigned int version_;
+        std::vector<size_t> offsets_;
+
+        // version 4 prefix-compresses paths, so they are expanded once on open
+        std::vector<size_t> path_offsets_;
+        std::vector<char> paths_;
+    };
+}
@@ -2,6 +2,7 @@
 
 namespace git
 {
+    /// Initializes libgit2, and allows it to open repositories whose refs are stored in a reftable
     struct Initializer
     {
         Initializer();
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+namespace git
+{
+    /// Instrumentation of the wrappers, off by default.
+    /// While both metrics and tracing are off an instrumented call costs one relaxed atomic load.
+    namespace metrics
+    {
+        enum class Operation
+        {
+            commit_lookup,
+            tree_lookup,
+            blob_lookup,
+            odb_read,
+            diff,
+            diff_print,
+            status,
+            blame_file,
+            fetch,
+        };
+        const size_t operation_count = 9;
+
+        const char * name(Operation);
+
+        /// Starts or stops collecting counters and latencies; collected values are kept
+        void enable(bool);
+        bool enabled();
+
+        struct Latency
+        {
+            /// bucket 0 counts calls faster than 1us, bucket i > 0 those taking [2^(i-1), 2^i) us
+            static const size_t buckets = 32;
+
+            uint64_t count = 0;
+            uint64_t total_ns = 0;
+            uint64_t max_ns = 0;
+            std::array<uint64_t, buckets> histogram = {};
+
+            /// Upper bound of the bucket the q-quantile falls into, in microseconds
+            double quantile_us(double q) const;
+        };
+
+        struct Snapshot
+        {
+            std::array<Latency, operation_count> operations;
+            /// object data handed out by Odb::read and blob_lookup
+            uint64_t bytes_inflated = 0;
+            /// lookups answered by a Repository's ObjectCache, see Repository::enable_object_cache
+            uint64_t cache_hits = 0;
+            uint64_t cache_misses = 0;
+
+            Latency const & operator[](Operation op) const { return operations[static_cast<size_t>(op)]; }
+            double cache_hit_rate() const;
+        };
+
+        /// Values collected since the last reset
+        Snapshot snapshot();
+        void reset();
+
+        /// Records every instrumented call as a span, keeping the first `max_events` of them
+        void start_trace(size_t max_events = 1 << 20);
+        /// Stops recording and writes the spans as Chrome trace event JSON,
+        /// for chrome://tracing or Perfetto
+        void stop_trace(std::ostream &);
+    }
+}
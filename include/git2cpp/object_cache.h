@@ -0,0 +1,50 @@
+#pragma once
+
+#include <git2/types.h>
+
+#include <memory>
+
+namespace git
+{
+    /// Thread-safe LRU cache of parsed objects, split into shards by the first byte
+    /// of the oid, so that lookups of different objects rarely contend for a lock.
+    /// Commits, trees and tags share one byte budget; blobs have their own, so large
+    /// blobs can't evict hot trees. Sizes are approximate in-memory sizes.
+    struct ObjectCache
+    {
+        struct Budget
+        {
+            size_t commits_and_trees = 64 << 20;
+            size_t blobs = 32 << 20;
+        };
+
+        struct Stats
+        {
+            size_t hits = 0;
+            size_t misses = 0;
+            size_t evictions = 0;
+            size_t objects = 0;
+            size_t bytes = 0;
+        };
+
+        ObjectCache();
+        explicit ObjectCache(Budget const &);
+        ~ObjectCache();
+
+        ObjectCache(ObjectCache const &) = delete;
+        ObjectCache & operator=(ObjectCache const &) = delete;
+
+        /// @return new reference to the cached object, or nullptr
+        git_object * get(git_oid const &, git_object_t type);
+        /// The cache takes a reference of its own
+        void put(git_object *);
+
+        Stats stats() const;
+        void clear();
+
+    private:
+        struct Shard;
+        static const size_t shards_count = 16;
+        std::unique_ptr<Shard[]> shards_;
+    };
+}
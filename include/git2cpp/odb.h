@@ -4,7 +4,11 @@
 
 #include <git2/oid.h>
 
+#include <memory>
+#include <vector>
+
 struct git_odb;
+struct git_odb_backend;
 
 namespace git
 {
@@ -13,6 +17,45 @@ namespace git
         OdbObject read(git_oid const & oid) const;
         git_oid write(const void * data, size_t len, git_object_t type);
 
+        /// Keeps written objects in memory and stores them as a single packfile
+        /// with its index on commit, instead of one loose file per object.
+        /// Must not outlive the Odb it was created from.
+        struct BulkWriter
+        {
+            BulkWriter(BulkWriter &&) = default;
+            BulkWriter & operator=(BulkWriter &&) = default;
+
+            git_oid write(const void * data, size_t len, git_object_t type);
+
+            /// Objects and bytes written since the last commit
+            size_t pending_objects() const { return pending_.size(); }
+            size_t pending_bytes() const { return pending_bytes_; }
+
+            /// Packs pending objects (with delta compression, on all cores), indexes the pack into
+            /// the repository, and starts over; a no-op if nothing is pending.
+            /// The pack only becomes visible once it is completely written.
+            void commit();
+
+        private:
+            friend struct Odb;
+            explicit BulkWriter(git_odb * target);
+
+        private:
+            struct DestroyOdb { void operator() (git_odb *) const; };
+            struct DestroyRepository { void operator() (git_repository *) const; };
+
+            git_odb * target_;
+            std::unique_ptr<git_odb, DestroyOdb> odb_;
+            // mempack needs a repository to build a pack from; this one only wraps odb_
+            std::unique_ptr<git_repository, DestroyRepository> repo_;
+            git_odb_backend * mempack_;
+            std::vector<git_oid> pending_;
+            size_t pending_bytes_ = 0;
+        };
+
+        /// Objects written through it are not visible in this Odb before commit
+        BulkWriter bulk_writer();
+
     private:
         friend struct Repository;
         explicit Odb(git_repository * repo);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory_resource>
+
+namespace git
+{
+    /// Initializes libgit2 like Initializer, but routes every libgit2 allocation
+    /// to `resource` until shutdown.
+    /// The resource must be thread-safe and outlive the initializer. This must be the only
+    /// initialization of libgit2 in the process while it lives: libgit2 must not have been
+    /// initialized before, and no Initializer may be created until this one is destroyed.
+    struct PmrInitializer
+    {
+        explicit PmrInitializer(std::pmr::memory_resource & resource);
+        ~PmrInitializer();
+
+        PmrInitializer(PmrInitializer const &) = delete;
+        PmrInitializer & operator=(PmrInitializer const &) = delete;
+    };
+}
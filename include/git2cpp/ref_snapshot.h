@@ -0,0 +1,71 @@
+#pragma once
+
+#include <git2/oid.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace git
+{
+    namespace internal
+    {
+        struct FileMapping;
+    }
+
+    /// Immutable, sorted view of all references of a repository, read directly from
+    /// the memory-mapped `packed-refs` file merged with the loose refs under `refs/`.
+    /// Names of packed refs point into the mapping; no per-ref allocation is made.
+    /// HEAD and other pseudo-refs are not included.
+    /// If the repository stores its refs in a reftable, they are read from there instead.
+    /// Names of loose refs point into a buffer allocated once by the snapshot, which keeps
+    /// its address when the snapshot is moved; snapshots can't be copied.
+    struct RefSnapshot
+    {
+        struct Ref
+        {
+            std::string_view name;
+            git_oid id;                         ///< zero for symbolic refs
+            std::string_view symbolic_target;   ///< empty for direct refs
+            git_oid peeled;                     ///< valid if has_peeled
+            bool has_peeled;
+        };
+
+        /// @param commondir repository (common) directory holding `packed-refs` and `refs/`
+        explicit RefSnapshot(const char * commondir);
+
+        RefSnapshot(RefSnapshot const &) = delete;
+        RefSnapshot & operator=(RefSnapshot const &) = delete;
+        RefSnapshot(RefSnapshot &&) = default;
+        RefSnapshot & operator=(RefSnapshot &&) = default;
+
+        size_t size() const { return refs_.size(); }
+        /// Number of references stored as loose files; see Repository::compress_refs
+        size_t loose_count() const { return loose_count_; }
+        Ref const & operator[](size_t i) const { return refs_[i]; }
+
+        Ref const * begin() const { return refs_.data(); }
+        Ref const * end() const { return refs_.data() + refs_.size(); }
+
+        /// @return nullptr if there is no such reference
+        Ref const * find(std::string_view name) const;
+
+        /// Range [first, second) of references whose names start with prefix,
+        /// e.g. "refs/heads/" or "refs/pull/123/"
+        std::pair<size_t, size_t> prefix_range(std::string_view prefix) const;
+
+    private:
+        void read_reftable(std::string const & dir);
+        /// Allocates names_ and copies str into it
+        void set_names(std::string const & str);
+
+        struct Destroy { void operator() (internal::FileMapping *) const; };
+        std::unique_ptr<internal::FileMapping, Destroy> packed_;
+        // names and symbolic targets of loose refs, or of all refs read from a reftable
+        std::unique_ptr<char[]> names_;
+        std::vector<Ref> refs_;
+        size_t loose_count_;
+    };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <git2/oid.h>
+
+#include <string>
+#include <vector>
+
+struct git_repository;
+
+namespace git
+{
+    /// Stages reference creations, updates and deletions.
+    /// Every staged ref is locked and checked against the value the caller expects it to have
+    /// before any is written, so a conflict leaves all of them untouched.
+    /// With the files backend, deletions and updates of refs that only exist in `packed-refs`
+    /// (and are not logged) are written by a single rewrite of `packed-refs` under its lock;
+    /// the other refs are written as loose files one at a time, and if one of them fails,
+    /// those written before are put back. In a reftable the transaction is one new table.
+    struct RefTransaction
+    {
+        /// Fails if the reference already exists
+        void create(std::string name, git_oid const & target, std::string log_message = {});
+        /// Fails if the reference does not point to expected_old
+        void update(std::string name, git_oid const & target, git_oid const & expected_old, std::string log_message = {});
+        /// Fails if the reference does not point to expected_old
+        void remove(std::string name, git_oid const & expected_old);
+
+        size_t size() const { return ops_.size(); }
+
+        struct Conflict
+        {
+            enum class Reason
+            {
+                locked,             ///< somebody else holds the lock
+                already_exists,
+                unexpected_value    ///< missing, symbolic or pointing elsewhere
+            };
+
+            std::string name;
+            Reason reason;
+        };
+
+        /// Applies the staged operations if there are no conflicts and clears the transaction.
+        /// Throws ref_transaction_error if writing fails, after putting back the refs written
+        /// so far as well as it can; the staged operations are kept.
+        /// @return conflicts; if not empty nothing was written and the staged operations are kept
+        std::vector<Conflict> commit();
+
+    private:
+        friend struct Repository;
+
+        explicit RefTransaction(git_repository * repo)
+            : repo_(repo)
+        {}
+
+        enum class Kind { create, update, remove };
+
+        struct Op
+        {
+            Kind kind;
+            std::string name;
+            git_oid target;
+            git_oid expected_old;
+            std::string log_message;
+        };
+
+        std::vector<Conflict> commit_reftable(const char * commondir);
+        /// Restores the expected old values of the refs that already have their new ones
+        void roll_back();
+
+        git_repository * repo_;
+        std::vector<Op> ops_;
+    };
+}
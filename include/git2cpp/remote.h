@@ -1,6 +1,8 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
 struct git_remote;
 struct git_oid;
@@ -14,6 +16,21 @@ namespace git
         const char * url()      const;
         const char * pushurl()  const;
 
+        /// Throughput of the current phase of receiving and indexing a pack
+        struct TransferRate
+        {
+            enum class Phase
+            {
+                receiving,
+                resolving_deltas
+            };
+
+            Phase phase;
+            double seconds;             ///< since the phase started
+            double objects_per_second;  ///< received objects or resolved deltas
+            double bytes_per_second;    ///< received bytes, 0 while resolving deltas
+        };
+
         struct FetchCallbacks
         {
         protected:
@@ -23,11 +40,45 @@ namespace git
             virtual void update_tips(char const * refname, git_oid const & a, git_oid const & b) {}
             virtual void sideband_progress(char const * str, int len) {}
             virtual void transfer_progress(git_indexer_progress const &) {}
+            virtual void transfer_rate(TransferRate const &) {}
 
             virtual git_credential* acquire_cred(const char * url, const char * username_from_url, unsigned int allowed_types) = 0;
         };
 
+        /// What a fetch (or clone) transfers besides the callbacks
+        struct FetchOptions
+        {
+            /// Fetch at most `depth` commits of history from each tip; 0 means full history.
+            /// Requires libgit2 1.7 or newer, otherwise fetching throws fetch_depth_unsupported_error.
+            FetchOptions & fetch_depth(int);
+            /// Fetch the missing history of a shallow repository
+            FetchOptions & unshallow();
+            /// Compare the ref advertisement with the local tracking refs first, and
+            /// ask only for the refs that moved. If none did, no pack is transferred, but
+            /// FETCH_HEAD is written and stale refs are pruned as usual.
+            /// Tags that tag auto-following would create, or that GIT_REMOTE_DOWNLOAD_TAGS_ALL
+            /// would update, count as moved.
+            FetchOptions & fetch_only_changed_refs();
+
+            int depth() const { return depth_; }
+            bool only_changed_refs() const { return only_changed_refs_; }
+
+        private:
+            int depth_ = 0;
+            bool only_changed_refs_ = false;
+        };
+
+        struct FetchStats
+        {
+            size_t advertised_refs = 0;
+            size_t matching_refs = 0;   ///< advertised refs covered by the fetch refspecs
+            size_t changed_refs = 0;    ///< matching refs requested from the remote
+            bool transferred = false;   ///< false if the pack negotiation was skipped or failed
+            int error = 0;              ///< raw libgit2 error code
+        };
+
         void fetch(FetchCallbacks &, char const * reflog_message = nullptr);
+        FetchStats fetch(FetchCallbacks &, FetchOptions const &, char const * reflog_message = nullptr);
 
     private:
         friend struct Repository;
@@ -4,10 +4,17 @@
 
 #include "blame.h"
 #include "blob.h"
+#include "changed_path_filters.h"
 #include "commit.h"
+#include "commit_graph.h"
+#include "commit_view.h"
 #include "diff.h"
 #include "index.h"
+#include "index_view.h"
+#include "object_cache.h"
 #include "odb.h"
+#include "ref_snapshot.h"
+#include "ref_transaction.h"
 #include "reference.h"
 #include "remote.h"
 #include "revspec.h"
@@ -17,7 +24,9 @@
 #include "str_array.h"
 #include "submodule.h"
 #include "tag.h"
+#include "tagged_mask.h"
 #include "tree.h"
+#include "tree_builder.h"
 
 #include "internal/optional.h"
 
@@ -29,6 +38,23 @@ struct git_blame_options;
 
 namespace git
 {
+    namespace repository_open
+    {
+        typedef tagged_mask_t<struct tag> flags;
+
+        extern const flags none;
+        /// open exactly the given directory, don't look in parent directories
+        extern const flags no_search;
+        /// keep searching across filesystem boundaries
+        extern const flags cross_fs;
+        /// open as bare, skipping the workdir setup
+        extern const flags bare;
+        /// don't append "/.git" to the given path
+        extern const flags no_dotgit;
+        /// take the repository location from GIT_DIR and friends
+        extern const flags from_env;
+    }
+
     struct non_existing_branch_error
     {};
     struct missing_head_error
@@ -64,7 +90,17 @@ namespace git
     struct Repository
     {
         Commit commit_lookup(git_oid const & oid) const;
+        /// Cheaper than commit_lookup when only ids, parents or the time are needed.
+        /// Reads the shallow grafts on every call: pass them in when viewing many commits.
+        CommitView commit_view(git_oid const & oid) const;
+        CommitView commit_view(git_oid const & oid, ShallowGrafts const &) const;
+        /// Empty unless the repository is shallow; also empty before libgit2 1.7,
+        /// whose Commit::parents_num reports the raw parents of grafted commits
+        ShallowGrafts shallow_grafts() const;
         Tree tree_lookup(git_oid const & oid) const;
+        /// Builder starting from an empty tree
+        TreeBuilder tree_builder() const;
+        TreeBuilder tree_builder(Tree const & base) const;
         Tag tag_lookup(git_oid const & oid) const;
         Blob blob_lookup(git_oid const & oid) const;
 
@@ -82,6 +118,8 @@ namespace git
         Object entry_to_object(Tree::BorrowedEntry) const;
 
         Index index() const;
+        /// read-only view of the on-disk index, see IndexView
+        IndexView index_view() const;
         Odb odb() const;
 
         Diff diff(Tree &, Tree &, git_diff_options const &) const;
@@ -97,6 +135,30 @@ namespace git
         git_repository_state_t state() const;
 
         StrArray reference_list() const;
+        /// Reads all references at once, without going through libgit2's refdb
+        RefSnapshot ref_snapshot() const;
+        /// Packs all loose references into `packed-refs`, or merges the tables of a reftable into one
+        /// @return raw error code
+        int compress_refs();
+        /// Moves HEAD and all references into a reftable, like `git refs migrate --ref-format=reftable`.
+        /// Reflogs are left behind and no new ones are written. Repositories stored this way
+        /// are detected when opened, and all reference operations go through the reftable;
+        /// git needs version 2.45 or newer to read them.
+        /// Not atomic: a failure after the reftable is written leaves both formats in place.
+        /// @return raw error code; GIT_EEXISTS if the refs are in a reftable already
+        int convert_refs_to_reftable();
+        /// The transaction must not outlive the repository
+        RefTransaction ref_transaction();
+
+        /// Writes the commit-graph for all commits reachable from references and HEAD, like
+        /// `git commit-graph write --reachable`, with changed-path filters by default.
+        /// A single file takes precedence over a chain, so writing a new chain layer removes it.
+        /// Generation numbers are topological levels; no corrected commit dates are stored.
+        /// Shallow repositories are refused with GIT_EINVALID, as git does.
+        /// @return raw error code
+        int write_commit_graph(CommitGraphOptions const & = {});
+        /// Filters written by `git commit-graph write --changed-paths`, if any
+        ChangedPathFilters changed_path_filters() const;
 
         std::vector<Reference> branches(branch_type, git_reference_t ref_kind = GIT_REFERENCE_ALL) const;
 
@@ -109,6 +171,7 @@ namespace git
         AnnotatedCommit annotated_commit_lookup(git_oid const &) const;
 
         bool is_bare() const;
+        bool is_shallow() const;
 
         Reference head() const;
         Reference ref(const char * name) const;
@@ -116,6 +179,8 @@ namespace git
         Submodule submodule_lookup(const char * name) const;
 
         const char * path() const;
+        /// Directory shared by all worktrees of the repository, same as path() for the main one
+        const char * commondir() const;
         const char * workdir() const;
 
         git_oid create_commit(const char * update_ref,
@@ -152,6 +217,19 @@ namespace git
         int checkout_tree(Commit const &, git_checkout_options const &);
         int checkout_head(git_checkout_options const &);
 
+        /// Same as above, but blobs are inflated, filtered and written by `workers`
+        /// threads, each directory being written by a single one of them.
+        /// Conflicts and notifications are still checked by libgit2 (as a dry run);
+        /// progress and perfdata callbacks are called on the calling thread, as usual.
+        /// `.gitattributes` files are written first, and the other files are filtered
+        /// with the attributes of the work tree, as in a serial checkout.
+        /// Only SAFE or FORCE (optionally with DONT_UPDATE_INDEX) checkouts of the
+        /// whole tree run in parallel, other options fall back to the serial version,
+        /// as do repositories with in-memory objects.
+        /// @return raw error code
+        int checkout_tree(Commit const &, git_checkout_options const &, unsigned int workers);
+        int checkout_head(git_checkout_options const &, unsigned int workers);
+
         /// @return raw error code
         int set_head(char const* ref);
         int set_head_detached(git_oid const&);
@@ -161,6 +239,8 @@ namespace git
 
         explicit Repository(const char * dir);
         explicit Repository(std::string const & dir);
+        /// @param ceiling_dirs GIT_PATH_LIST_SEPARATOR separated directories where the search stops
+        Repository(const char * dir, repository_open::flags, const char * ceiling_dirs = nullptr);
 
         struct init_tag
         {};
@@ -169,15 +249,45 @@ namespace git
         Repository(const char * dir, init_tag, git_repository_init_options opts);
         Repository(std::string const & dir, init_tag);
 
+        struct in_memory_tag
+        {};
+        static const in_memory_tag in_memory;
+        /// Bare repository without any files: objects live in an in-memory odb backend,
+        /// and there is no config and no refdb.
+        /// path() and workdir() return nullptr, index_view() and ref_snapshot() throw,
+        /// write_commit_graph() fails with GIT_ENOTFOUND and changed_path_filters() is empty.
+        explicit Repository(in_memory_tag);
+
+        /// Adds an in-memory odb backend in front of the on-disk ones: all object writes
+        /// go to memory from now on, reads look there first
+        void add_in_memory_odb();
+
+        /// True for in-memory repositories and after add_in_memory_odb(): some objects exist
+        /// only in this handle, so parallel checkouts and tree walks, which reopen the
+        /// repository from disk on every thread, run serially instead
+        bool has_in_memory_odb() const { return in_memory_odb_; }
+
+        /// Keeps commits, trees and blobs found by *_lookup in a cache owned by this repository
+        void enable_object_cache(ObjectCache::Budget const &);
+        /// @return nullptr if the cache is not enabled
+        ObjectCache const * object_cache() const { return cache_.get(); }
+
         static Repository clone(const char * url, const char* path, git_checkout_options const &, Remote::FetchCallbacks &);
+        static Repository clone(const char * url, const char* path, git_checkout_options const &, Remote::FetchCallbacks &, Remote::FetchOptions const &);
 
         static internal::optional<std::string> discover(const char * start_path);
+        static internal::optional<std::string> discover(const char * start_path, bool across_fs, const char * ceiling_dirs);
 
     private:
         struct Destroy { void operator() (git_repository *) const; };
         std::unique_ptr<git_repository, Destroy> repo_;
+        std::unique_ptr<ObjectCache> cache_;
+        bool in_memory_odb_ = false;
 
         explicit Repository(git_repository*);
+
+        /// @return new reference or nullptr
+        git_object * lookup_cached(git_oid const &, git_object_t) const;
     };
 
     Object revparse_single(Repository const & repo, const char * spec);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "repo.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace git
+{
+    /// Keeps opened repositories for reuse. A handle is used by one thread at a time
+    /// and goes back to the pool when its Lease is destroyed.
+    /// Idle handles are dropped once the repository config, packed-refs
+    /// or the set of packs has changed on disk.
+    /// Only repositories opened from disk are pooled; a leased handle must not be given
+    /// an in-memory odb (Repository::add_in_memory_odb), as it is reused by later leases.
+    struct RepositoryPool
+    {
+        /// @param max_idle handles kept per path while nobody uses them
+        explicit RepositoryPool(size_t max_idle = 4);
+
+        RepositoryPool(RepositoryPool const &) = delete;
+        RepositoryPool & operator=(RepositoryPool const &) = delete;
+
+    private:
+        struct Stamp
+        {
+            std::chrono::nanoseconds config, packed_refs, packs;
+            bool operator==(Stamp const &) const;
+        };
+
+        struct Idle
+        {
+            std::unique_ptr<Repository> repo;
+            Stamp stamp;
+        };
+
+        struct Slot
+        {
+            std::string commondir;  ///< empty until the first handle is opened
+            std::vector<Idle> idle;
+        };
+
+    public:
+        /// Must not outlive the pool
+        struct Lease
+        {
+            Lease(Lease &&) = default;
+            Lease & operator=(Lease &&) = delete;
+            ~Lease();
+
+            Repository & operator*() const { return *repo_; }
+            Repository * operator->() const { return repo_.get(); }
+
+        private:
+            friend struct RepositoryPool;
+            Lease(RepositoryPool &, Slot &, std::unique_ptr<Repository>, Stamp);
+
+        private:
+            RepositoryPool * pool_;
+            Slot * slot_;
+            std::unique_ptr<Repository> repo_;
+            Stamp stamp_;
+        };
+
+        /// Reuses an idle handle for the path if it is still current, opens a new one otherwise
+        Lease acquire(std::string const & path);
+
+        /// Drops all idle handles
+        void clear();
+
+    private:
+        static Stamp stamp(std::string const & commondir);
+
+    private:
+        size_t max_idle_;
+        std::mutex mutex_;
+        std::map<std::string, Slot> slots_;
+    };
+}
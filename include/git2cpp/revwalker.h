@@ -1,7 +1,11 @@
 #pragma once
 
 #include "commit.h"
+#include "commit_view.h"
 #include "tagged_mask.h"
+
+#include <memory>
+#include <string>
 #include <utility>
 
 namespace git
@@ -31,16 +35,47 @@ namespace git
         void sort(revwalker::sorting::type);
         void simplify_first_parent();
 
+        /// Only yields commits that change the file or directory at `path` (or one of the paths
+        /// if called several times), like `git log -- <paths>`: a merge with the same content at
+        /// the paths as one of its parents is skipped along with the history reachable only
+        /// through its other parents.
+        /// Trees are compared only along the paths, after consulting changed-path filters
+        /// of the commit-graph if there are any. The walk becomes topological.
+        /// Throws revwalk_started_error if paths were pushed and the walk already started.
+        void push_path(std::string path);
+        /// With push_path, before or after it: follow all parents of merges and yield
+        /// merges differing from at least one parent, like `--full-history`
+        void full_history();
+
         void push_head() const;
         void hide(git_oid const &) const;
         void push(git_oid const &) const;
 
         Commit next() const;
         bool next(char * id_buffer) const;
+        /// @return empty view at the end
+        CommitView next_view() const;
+
+    private:
+        bool next_id(git_oid &) const;
+        void apply_sorting();
+        /// Read on first use, for the whole walk
+        ShallowGrafts const & shallow() const;
 
     private:
         struct Destroy { void operator() (git_revwalk*) const; };
         std::unique_ptr<git_revwalk, Destroy> walker_;
         Repository const * repo_;
+
+        revwalker::sorting::type sorting_;
+        bool first_parent_ = false;
+        bool full_history_ = false;
+
+        mutable bool shallow_read_ = false;
+        mutable ShallowGrafts shallow_;
+
+        struct PathLimit;
+        struct DestroyPathLimit { void operator() (PathLimit *) const; };
+        std::unique_ptr<PathLimit, DestroyPathLimit> paths_;
     };
 }
@@ -2,7 +2,9 @@
 
 #include "pathspec.h"
 
+#include <functional>
 #include <memory>
+#include <string>
 
 namespace git
 {
@@ -20,6 +22,7 @@ namespace git
         private:
             friend struct Tree;
             friend struct Repository;
+            friend struct TreePathCache;
 
             explicit BorrowedEntry(git_tree_entry const * entry)
                 : entry_(entry)
@@ -62,12 +65,26 @@ namespace git
 
         OwnedEntry find(const char * path) const;
 
+        /// Gets the entry path relative to this tree (valid only during the call);
+        /// returning false for a subtree skips everything below it
+        typedef std::function<bool (const char * path, BorrowedEntry const &)> WalkVisitor;
+
+        /// Visits all entries below this tree in pre-order, reusing one path buffer
+        void walk(WalkVisitor const &) const;
+        /// Walks subtrees of this tree on `workers` threads, each with its own repository handle.
+        /// The visitor is called concurrently and the order of entries is unspecified.
+        /// Runs serially for repositories with in-memory objects, see Repository::has_in_memory_odb.
+        void walk(WalkVisitor const &, unsigned int workers) const;
+
         Tree(git_tree *, Repository const &);
 
         Tree() = default;
 
         explicit operator bool() const { return tree_ != nullptr; }
 
+    private:
+        static void walk(git_repository *, git_tree const *, std::string & path, WalkVisitor const &);
+
     private:
         struct Destroy { void operator() (git_tree*) const; };
         std::unique_ptr<git_tree, Destroy> tree_;
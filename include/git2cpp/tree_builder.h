@@ -0,0 +1,43 @@
+#pragma once
+
+#include <git2/tree.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace git
+{
+    struct Repository;
+    struct Tree;
+
+    /// Applies path-level edits to a base tree without an index.
+    /// Only the trees along edited paths are written.
+    struct TreeBuilder
+    {
+        TreeBuilder & upsert(std::string path, git_oid const & blob, git_filemode_t = GIT_FILEMODE_BLOB);
+        /// Writes the blob right away
+        TreeBuilder & upsert(std::string path, const void * data, size_t size, git_filemode_t = GIT_FILEMODE_BLOB);
+        TreeBuilder & remove(std::string path);
+
+        size_t pending() const { return updates_.size(); }
+
+        /// Writes the edited tree, which becomes the base for further edits
+        Tree write();
+
+    private:
+        friend struct Repository;
+
+        TreeBuilder(git_repository *, Repository const &, git_tree const * base);
+
+    private:
+        git_repository * repo_;
+        Repository const * owner_;
+
+        struct Destroy { void operator() (git_tree *) const; };
+        std::unique_ptr<git_tree, Destroy> base_;
+
+        // later edits of a path replace earlier ones
+        std::map<std::string, git_tree_update> updates_;
+    };
+}
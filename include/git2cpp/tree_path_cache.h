@@ -0,0 +1,41 @@
+#pragma once
+
+#include "internal/optional.h"
+#include "tree.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace git
+{
+    /// Resolves many paths below one root tree, keeping every directory it had to read.
+    /// A lookup whose directory was seen before costs one hash probe and one binary
+    /// search in that directory, instead of one tree read per path component.
+    struct TreePathCache
+    {
+        explicit TreePathCache(Tree const & root);
+
+        git_oid const & root_id() const;
+
+        /// The entry lives as long as the cache
+        internal::optional<Tree::BorrowedEntry> find(std::string_view path);
+
+        size_t cached_dirs() const { return dirs_.size(); }
+
+    private:
+        /// nullptr if the directory does not exist or is not a tree
+        git_tree const * dir(std::string_view path);
+
+    private:
+        struct Destroy { void operator() (git_tree *) const; };
+        std::vector<std::unique_ptr<git_tree, Destroy>> trees_;
+
+        // keys are views into dir_names_, which never moves its elements
+        std::deque<std::string> dir_names_;
+        std::unordered_map<std::string_view, git_tree const *> dirs_;
+    };
+}
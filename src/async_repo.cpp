@@ -0,0 +1,175 @@
+#include "git2cpp/async_repo.h"
+
+#include <algorithm>
+
+namespace git
+{
+    AsyncExecutor::AsyncExecutor(unsigned int threads)
+    {
+        threads = std::max(threads, 1u);
+        threads_.reserve(threads);
+        for (unsigned int i = 0; i != threads; ++i)
+        {
+            threads_.emplace_back([this]
+            {
+                for (;;)
+                {
+                    std::function<void ()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                        if (tasks_.empty())
+                            return;
+                        task = std::move(tasks_.front());
+                        tasks_.pop_front();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    AsyncExecutor::~AsyncExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto & thread : threads_)
+            thread.join();
+    }
+
+    void AsyncExecutor::post(std::function<void ()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    AsyncRepository::AsyncRepository(AsyncExecutor & executor, Repository repo)
+        : executor_(executor)
+        , repo_(std::move(repo))
+    {
+    }
+
+    AsyncRepository::~AsyncRepository()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return !running_; });
+    }
+
+    void AsyncRepository::enqueue(std::function<void (Repository &)> op)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(op));
+            if (running_)
+                return;
+            running_ = true;
+        }
+        executor_.post([this] { drain(); });
+    }
+
+    // runs on one executor thread at a time; operations posted meanwhile join the same run
+    void AsyncRepository::drain()
+    {
+        for (;;)
+        {
+            std::function<void (Repository &)> op;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (queue_.empty())
+                {
+                    running_ = false;
+                    idle_.notify_all();
+                    return;
+                }
+                op = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            op(repo_);
+        }
+    }
+
+    // continuations run as separate executor tasks, so they may block or destroy this object
+    void AsyncRepository::resume(std::function<void ()> continuation)
+    {
+        executor_.post([resumer = resumer_, continuation = std::move(continuation)]
+        {
+            if (resumer)
+                resumer(continuation);
+            else
+                continuation();
+        });
+    }
+
+    namespace internal
+    {
+        void AsyncCompletion::finish()
+        {
+            std::function<void ()> continuation;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                finished_ = true;
+                continuation = std::move(continuation_);
+            }
+            if (continuation)
+                repo_.resume(std::move(continuation));
+        }
+
+        bool AsyncCompletion::then(std::function<void ()> continuation)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (finished_)
+                return false;
+            continuation_ = std::move(continuation);
+            return true;
+        }
+    }
+
+    AsyncFuture<Commit> AsyncRepository::commit_lookup(git_oid const & id)
+    {
+        return submit([id] (Repository & repo) { return repo.commit_lookup(id); });
+    }
+
+    AsyncFuture<Tree> AsyncRepository::tree_lookup(git_oid const & id)
+    {
+        return submit([id] (Repository & repo) { return repo.tree_lookup(id); });
+    }
+
+    AsyncFuture<Blob> AsyncRepository::blob_lookup(git_oid const & id)
+    {
+        return submit([id] (Repository & repo) { return repo.blob_lookup(id); });
+    }
+
+    AsyncFuture<Diff> AsyncRepository::diff(git_oid const & old_tree, git_oid const & new_tree, git_diff_options const & opts)
+    {
+        return submit([old_tree, new_tree, opts] (Repository & repo)
+        {
+            auto a = repo.tree_lookup(old_tree);
+            auto b = repo.tree_lookup(new_tree);
+            return repo.diff(a, b, opts);
+        });
+    }
+
+    AsyncFuture<Status> AsyncRepository::status(Status::Options const & opts)
+    {
+        return submit([opts] (Repository & repo) { return repo.status(opts); });
+    }
+
+    AsyncFuture<Blame> AsyncRepository::blame_file(std::string path, git_blame_options const & opts)
+    {
+        return submit([path = std::move(path), opts] (Repository & repo) { return repo.blame_file(path.c_str(), opts); });
+    }
+
+    AsyncFuture<Remote::FetchStats> AsyncRepository::fetch(std::string remote, Remote::FetchCallbacks & callbacks, Remote::FetchOptions const & opts)
+    {
+        return submit([remote = std::move(remote), &callbacks, opts] (Repository & repo)
+        {
+            return repo.remote(remote.c_str()).fetch(callbacks, opts);
+        });
+    }
+}
@@ -0,0 +1,138 @@
+#include "git2cpp/changed_path_filters.h"
+
+#include "commit_graph_file.h"
+#include "file_mapping.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace git
+{
+    ChangedPathFilters::Path::Path(std::string_view path)
+    {
+        while (!path.empty() && path.back() == '/')
+            path.remove_suffix(1);
+
+        // a change below a directory is also recorded for the directory itself
+        for (;;)
+        {
+            Key key;
+            key.hash0[0] = internal::murmur3<signed char>(internal::commit_graph::bloom_seed0, path);
+            key.hash1[0] = internal::murmur3<signed char>(internal::commit_graph::bloom_seed1, path);
+            key.hash0[1] = internal::murmur3<unsigned char>(internal::commit_graph::bloom_seed0, path);
+            key.hash1[1] = internal::murmur3<unsigned char>(internal::commit_graph::bloom_seed1, path);
+            keys_.push_back(key);
+
+            const size_t slash = path.rfind('/');
+            if (slash == std::string_view::npos)
+                break;
+            path = path.substr(0, slash);
+        }
+    }
+
+    void ChangedPathFilters::Destroy::operator()(Layer * layer) const
+    {
+        delete layer;
+    }
+
+    bool ChangedPathFilters::load(Layer & layer, const char * path)
+    {
+        layer.file.reset(new internal::FileMapping(path));
+        internal::FileMapping const & file = *layer.file;
+        internal::CommitGraphChunks chunks;
+        if (!file || !chunks.parse(file.data(), file.size()) || !chunks.bloom_index || !chunks.bloom_data)
+            return false;
+
+        layer.fanout = chunks.fanout;
+        layer.oids = chunks.oids;
+        layer.index = chunks.bloom_index;
+        layer.commits = chunks.commits;
+        layer.hash_version = internal::read_u32(chunks.bloom_data);
+        layer.num_hashes = internal::read_u32(chunks.bloom_data + 4);
+        layer.filters = chunks.bloom_data + internal::commit_graph::bloom_header_size;
+        layer.filters_size = chunks.bloom_data_size - internal::commit_graph::bloom_header_size;
+        return (layer.hash_version == 1 || layer.hash_version == 2) && layer.num_hashes != 0;
+    }
+
+    ChangedPathFilters::ChangedPathFilters(const char * objects_dir)
+    {
+        const std::string info = std::string(objects_dir) + "/info/";
+
+        // git prefers a single commit-graph file over a chain
+        std::unique_ptr<Layer, Destroy> single(new Layer);
+        if (load(*single, (info + "commit-graph").c_str()))
+        {
+            layers_.push_back(std::move(single));
+            return;
+        }
+        if (*single->file)
+            return;
+
+        std::ifstream chain(info + "commit-graphs/commit-graph-chain");
+        std::string hash;
+        while (chain >> hash)
+        {
+            std::unique_ptr<Layer, Destroy> layer(new Layer);
+            if (load(*layer, (info + "commit-graphs/graph-" + hash + ".graph").c_str()))
+                layers_.push_back(std::move(layer));
+        }
+    }
+
+    size_t ChangedPathFilters::size() const
+    {
+        size_t res = 0;
+        for (auto const & layer : layers_)
+            res += layer->commits;
+        return res;
+    }
+
+    ChangedPathFilters::Answer ChangedPathFilters::maybe_changed(git_oid const & commit, Path const & path) const
+    {
+        using internal::read_u32;
+
+        for (auto const & layer : layers_)
+        {
+            const unsigned char first = commit.id[0];
+            uint32_t lo = first ? read_u32(layer->fanout + (first - 1) * 4) : 0;
+            uint32_t hi = read_u32(layer->fanout + first * 4);
+            while (lo < hi)
+            {
+                const uint32_t mid = lo + (hi - lo) / 2;
+                const int cmp = std::memcmp(layer->oids + size_t(mid) * GIT_OID_RAWSZ, commit.id, GIT_OID_RAWSZ);
+                if (cmp == 0)
+                {
+                    lo = mid;
+                    hi = mid + 1;
+                    break;
+                }
+                if (cmp < 0)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            if (lo == hi)
+                continue;
+
+            const size_t begin = lo ? read_u32(layer->index + (lo - 1) * 4) : 0;
+            const size_t end = read_u32(layer->index + lo * 4);
+            if (begin >= end || end > layer->filters_size)
+                return Answer::unknown;
+
+            unsigned char const * filter = layer->filters + begin;
+            const uint64_t bits = uint64_t(end - begin) * 8;
+            const size_t version = layer->hash_version - 1;
+            for (auto const & key : path.keys_)
+            {
+                for (uint32_t i = 0; i != layer->num_hashes; ++i)
+                {
+                    const uint64_t bit = uint32_t(key.hash0[version] + i * key.hash1[version]) % bits;
+                    if (!(filter[bit / 8] & (1 << (bit % 8))))
+                        return Answer::no;
+                }
+            }
+            return Answer::maybe;
+        }
+        return Answer::unknown;
+    }
+}
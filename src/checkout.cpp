@@ -0,0 +1,513 @@
+#include "git2cpp/repo.h"
+
+#include <git2/blob.h>
+#include <git2/checkout.h>
+#include <git2/diff.h>
+#include <git2/errors.h>
+#include <git2/index.h>
+#include <git2/repository.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace git
+{
+    namespace
+    {
+        struct FileUpdate
+        {
+            std::string path;
+            size_t dir_len;
+            git_oid id;
+            uint16_t mode;
+            git_index_entry stat;
+
+            bool is_attributes() const
+            {
+                return path.compare(dir_len ? dir_len + 1 : 0, std::string::npos, ".gitattributes") == 0;
+            }
+        };
+
+        struct DiffDestroy { void operator() (git_diff * diff) const { git_diff_free(diff); } };
+        typedef std::unique_ptr<git_diff, DiffDestroy> diff_ptr;
+
+        struct RepoDestroy { void operator() (git_repository * repo) const { git_repository_free(repo); } };
+        struct IndexDestroy { void operator() (git_index * index) const { git_index_free(index); } };
+
+        /// `target_is_new` tells which side of the deltas is the checkout target
+        void collect_updates(git_diff * diff, bool target_is_new,
+                             std::vector<FileUpdate> & writes, std::vector<std::string> & removes)
+        {
+            const auto missing_in_target = target_is_new ? GIT_DELTA_DELETED : GIT_DELTA_ADDED;
+            for (size_t i = 0, n = git_diff_num_deltas(diff); i != n; ++i)
+            {
+                auto delta = git_diff_get_delta(diff, i);
+                switch (delta->status)
+                {
+                case GIT_DELTA_ADDED:
+                case GIT_DELTA_DELETED:
+                case GIT_DELTA_MODIFIED:
+                case GIT_DELTA_TYPECHANGE:
+                    break;
+                default:
+                    continue;
+                }
+
+                auto const & target = target_is_new ? delta->new_file : delta->old_file;
+                auto const & current = target_is_new ? delta->old_file : delta->new_file;
+                if (delta->status == missing_in_target)
+                {
+                    removes.emplace_back(current.path);
+                }
+                else
+                {
+                    std::string path = target.path;
+                    const auto slash = path.rfind('/');
+                    const size_t dir_len = slash == std::string::npos ? 0 : slash;
+                    writes.push_back({std::move(path), dir_len, target.id, target.mode, {}});
+                }
+            }
+        }
+
+        bool stat_file(std::string const & path, git_index_entry & entry)
+        {
+#ifdef _WIN32
+            struct _stat64 st;
+            if (_stat64(path.c_str(), &st) != 0)
+                return false;
+#else
+            struct stat st;
+            if (::lstat(path.c_str(), &st) != 0)
+                return false;
+#endif
+            entry.ctime.seconds = static_cast<int32_t>(st.st_ctime);
+            entry.mtime.seconds = static_cast<int32_t>(st.st_mtime);
+#if defined(__APPLE__)
+            entry.ctime.nanoseconds = static_cast<uint32_t>(st.st_ctimespec.tv_nsec);
+            entry.mtime.nanoseconds = static_cast<uint32_t>(st.st_mtimespec.tv_nsec);
+#elif !defined(_WIN32)
+            entry.ctime.nanoseconds = static_cast<uint32_t>(st.st_ctim.tv_nsec);
+            entry.mtime.nanoseconds = static_cast<uint32_t>(st.st_mtim.tv_nsec);
+#endif
+            entry.dev = static_cast<uint32_t>(st.st_dev);
+            entry.ino = static_cast<uint32_t>(st.st_ino);
+            entry.uid = static_cast<uint32_t>(st.st_uid);
+            entry.gid = static_cast<uint32_t>(st.st_gid);
+            entry.file_size = static_cast<uint32_t>(st.st_size);
+            return true;
+        }
+
+        struct ParallelCheckout
+        {
+            ParallelCheckout(git_repository * repo, git_checkout_options const & options, std::vector<FileUpdate> & writes)
+                : repo_(repo)
+                , gitdir_(git_repository_path(repo))
+                , workdir_(git_repository_workdir(repo))
+                , options_(options)
+                , writes_(writes)
+            {
+                // one group per directory, so that no two workers write into the same one
+                std::sort(writes_.begin(), writes_.end(), [](FileUpdate const & a, FileUpdate const & b) {
+                    if (int cmp = a.path.compare(0, a.dir_len, b.path, 0, b.dir_len))
+                        return cmp < 0;
+                    return a.path < b.path;
+                });
+                for (size_t i = 0; i != writes_.size(); ++i)
+                {
+                    if (i == 0 || writes_[i].path.compare(0, writes_[i].dir_len, writes_[i - 1].path, 0, writes_[i - 1].dir_len) != 0)
+                        groups_.push_back(i);
+                }
+                groups_.push_back(writes_.size());
+            }
+
+            int make_directories()
+            {
+                std::error_code ec;
+                for (size_t g = 0; g + 1 < groups_.size(); ++g)
+                {
+                    auto const & file = writes_[groups_[g]];
+                    if (file.dir_len == 0)
+                        continue;
+                    const auto dir = fs::u8path(workdir_ + file.path.substr(0, file.dir_len));
+                    if (fs::create_directories(dir, ec))
+                        ++perfdata_.mkdir_calls;
+                    else if (ec)
+                    {
+                        git_error_set_str(GIT_ERROR_OS, ("could not create directory '" + file.path.substr(0, file.dir_len) + "': " + ec.message()).c_str());
+                        return GIT_ERROR;
+                    }
+                }
+                return GIT_OK;
+            }
+
+            /// Progress is reported on the calling thread, as the workers complete files
+            int run(unsigned int workers)
+            {
+                if (options_.progress_cb)
+                    options_.progress_cb(nullptr, 0, writes_.size(), options_.progress_payload);
+
+                // the attributes of the target apply to the other files, as in a serial checkout
+                git_blob_filter_options filter_opts = GIT_BLOB_FILTER_OPTIONS_INIT;
+                for (size_t i = 0; i != writes_.size(); ++i)
+                {
+                    if (!writes_[i].is_attributes())
+                        continue;
+                    if (int err = write_file(repo_, writes_[i], filter_opts))
+                    {
+                        fail(err, "could not check out '" + writes_[i].path + "'");
+                        git_error_set_str(GIT_ERROR_CHECKOUT, error_message_.c_str());
+                        return err;
+                    }
+                    completed(i);
+                }
+                report_progress();
+
+                workers = static_cast<unsigned int>(std::min<size_t>(workers, groups_.size() - 1));
+                running_ = workers;
+                std::vector<std::thread> threads;
+                threads.reserve(workers);
+                try
+                {
+                    for (unsigned int i = 0; i < workers; ++i)
+                        threads.emplace_back([this] { work(); });
+                }
+                catch (std::system_error const & e)
+                {
+                    fail(GIT_ERROR, std::string("could not start a checkout worker: ") + e.what());
+                    std::lock_guard<std::mutex> lock(progress_mutex_);
+                    running_ -= workers - static_cast<unsigned int>(threads.size());
+                }
+
+                while (report_progress())
+                    ;
+                for (auto & t : threads)
+                    t.join();
+
+                perfdata_.stat_calls = stat_calls_;
+                perfdata_.chmod_calls = chmod_calls_;
+                if (options_.perfdata_cb)
+                    options_.perfdata_cb(&perfdata_, options_.perfdata_payload);
+
+                // libgit2 errors are per thread, so the worker's one is reported again here
+                if (error_ != GIT_OK)
+                    git_error_set_str(GIT_ERROR_CHECKOUT, error_message_.c_str());
+                return error_;
+            }
+
+        private:
+            void work()
+            {
+                try
+                {
+                    write_groups();
+                }
+                catch (std::exception const & e)
+                {
+                    fail(GIT_ERROR, e.what());
+                }
+
+                std::lock_guard<std::mutex> lock(progress_mutex_);
+                --running_;
+                progress_cv_.notify_one();
+            }
+
+            void write_groups()
+            {
+                git_repository * raw;
+                if (int err = git_repository_open(&raw, gitdir_.c_str()))
+                    return fail(err, "could not open '" + gitdir_ + "'");
+                std::unique_ptr<git_repository, RepoDestroy> repo(raw);
+
+                // attributes are read from the work tree, where the `.gitattributes` files are already written
+                git_blob_filter_options filter_opts = GIT_BLOB_FILTER_OPTIONS_INIT;
+
+                for (size_t g; error_ == GIT_OK && (g = next_group_++) + 1 < groups_.size();)
+                {
+                    for (size_t i = groups_[g]; i != groups_[g + 1]; ++i)
+                    {
+                        if (writes_[i].is_attributes())
+                            continue;
+                        git_error_clear();
+                        if (int err = write_file(repo.get(), writes_[i], filter_opts))
+                            return fail(err, "could not check out '" + writes_[i].path + "'");
+                        completed(i);
+                    }
+                }
+            }
+
+            int write_file(git_repository * repo, FileUpdate & file, git_blob_filter_options & filter_opts)
+            {
+                const std::string full_path = workdir_ + file.path;
+                const auto path = fs::u8path(full_path);
+                std::error_code ec;
+
+                if (file.mode == GIT_FILEMODE_COMMIT)
+                {
+                    // submodules are only given their directory, like libgit2 does
+                    fs::create_directories(path, ec);
+                    return ec ? GIT_ERROR : GIT_OK;
+                }
+
+                git_blob * raw_blob;
+                if (int err = git_blob_lookup(&raw_blob, repo, &file.id))
+                    return err;
+                Blob blob(raw_blob);
+
+                const char * data = static_cast<const char *>(blob.content());
+                size_t size = blob.size();
+
+                git_buf filtered = GIT_BUF_INIT;
+                if (!options_.disable_filters && file.mode != GIT_FILEMODE_LINK)
+                {
+                    if (int err = git_blob_filter(&filtered, raw_blob, file.path.c_str(), &filter_opts))
+                    {
+                        git_buf_dispose(&filtered);
+                        return err;
+                    }
+                    data = filtered.ptr;
+                    size = filtered.size;
+                }
+                Buffer filtered_guard(filtered);
+
+                // whatever is there now may be of another type (symlink, read-only file)
+                fs::remove(path, ec);
+
+#ifndef _WIN32
+                if (file.mode == GIT_FILEMODE_LINK)
+                {
+                    fs::create_symlink(std::string(data, size), path, ec);
+                    if (ec)
+                        return GIT_ERROR;
+                }
+                else
+#endif
+                {
+                    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                    out.write(data, static_cast<std::streamsize>(size));
+                    out.close();
+                    if (!out)
+                        return GIT_ERROR;
+
+                    if (options_.file_mode)
+                    {
+                        fs::permissions(path, static_cast<fs::perms>(options_.file_mode), fs::perm_options::replace, ec);
+                        ++chmod_calls_;
+                    }
+                    else if (file.mode == GIT_FILEMODE_BLOB_EXECUTABLE)
+                    {
+                        fs::permissions(path, fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec, fs::perm_options::add, ec);
+                        ++chmod_calls_;
+                    }
+                    if (ec)
+                        return GIT_ERROR;
+                }
+
+                ++stat_calls_;
+                return stat_file(full_path, file.stat) ? GIT_OK : GIT_ERROR;
+            }
+
+            void completed(size_t i)
+            {
+                if (!options_.progress_cb)
+                    return;
+                std::lock_guard<std::mutex> lock(progress_mutex_);
+                completed_files_.push_back(i);
+                progress_cv_.notify_one();
+            }
+
+            /// Waits for completed files, or for all workers to finish, and reports the files
+            /// @return false once all workers finished and everything is reported
+            bool report_progress()
+            {
+                std::vector<size_t> files;
+                bool running;
+                {
+                    std::unique_lock<std::mutex> lock(progress_mutex_);
+                    progress_cv_.wait(lock, [this] { return !completed_files_.empty() || running_ == 0; });
+                    files.swap(completed_files_);
+                    running = running_ != 0;
+                }
+                for (size_t i : files)
+                    options_.progress_cb(writes_[i].path.c_str(), ++reported_, writes_.size(), options_.progress_payload);
+                return running;
+            }
+
+            /// Only the first failure is kept; its message is completed with the
+            /// libgit2 error of the calling worker thread, if there is one
+            void fail(int err, std::string message)
+            {
+                int expected = GIT_OK;
+                if (!error_.compare_exchange_strong(expected, err))
+                    return;
+                if (auto last = git_error_last())
+                {
+                    message += ": ";
+                    message += last->message;
+                }
+                error_message_ = std::move(message);
+            }
+
+        private:
+            git_repository * const repo_;
+            const std::string gitdir_;
+            const std::string workdir_;
+            git_checkout_options const & options_;
+            std::vector<FileUpdate> & writes_;
+
+            std::vector<size_t> groups_;
+            std::atomic<size_t> next_group_{0};
+            std::atomic<int> error_{GIT_OK};
+            std::string error_message_;     ///< written by the thread that set error_, read after joining
+
+            std::mutex progress_mutex_;
+            std::condition_variable progress_cv_;
+            unsigned int running_ = 0;              ///< workers that have not finished
+            std::vector<size_t> completed_files_;   ///< written but not yet reported
+            size_t reported_ = 0;
+
+            git_checkout_perfdata perfdata_ = {};
+            std::atomic<size_t> stat_calls_{0};
+            std::atomic<size_t> chmod_calls_{0};
+        };
+
+        void remove_file(std::string const & workdir, std::string const & path)
+        {
+            const auto root = fs::u8path(workdir).parent_path();
+            auto file = fs::u8path(workdir + path);
+
+            std::error_code ec;
+            fs::remove(file, ec);
+
+            // drop directories left empty, so that a file may take their place
+            for (auto dir = file.parent_path(); dir != root && dir.native().size() > root.native().size(); dir = dir.parent_path())
+            {
+                if (!fs::is_empty(dir, ec) || ec || !fs::remove(dir, ec))
+                    break;
+            }
+        }
+    }
+
+    int Repository::checkout_tree(Commit const & commit, git_checkout_options const & options, unsigned int workers)
+    {
+        const unsigned int strategy = options.checkout_strategy;
+        const unsigned int supported = GIT_CHECKOUT_SAFE | GIT_CHECKOUT_FORCE | GIT_CHECKOUT_DONT_UPDATE_INDEX;
+        if (workers < 2
+            || is_bare()
+            || has_in_memory_odb()
+            || !(strategy & (GIT_CHECKOUT_SAFE | GIT_CHECKOUT_FORCE))
+            || (strategy & ~supported)
+            || options.paths.count
+            || options.target_directory
+            || options.baseline_index)
+        {
+            return checkout_tree(commit, options);
+        }
+
+        // conflict detection and notifications are left to libgit2, without touching anything
+        git_checkout_options dry_run = options;
+        dry_run.checkout_strategy |= GIT_CHECKOUT_DRY_RUN;
+        dry_run.progress_cb = nullptr;
+        dry_run.perfdata_cb = nullptr;
+        if (int err = checkout_tree(commit, dry_run))
+            return err;
+
+        Tree target = commit.tree();
+        std::vector<FileUpdate> writes;
+        std::vector<std::string> removes;
+
+        git_diff_options diff_opts = GIT_DIFF_OPTIONS_INIT;
+        diff_opts.flags |= GIT_DIFF_INCLUDE_TYPECHANGE;
+        diff_opts.ignore_submodules = GIT_SUBMODULE_IGNORE_ALL;
+
+        git_diff * raw_diff;
+        if (strategy & GIT_CHECKOUT_FORCE)
+        {
+            // everything where the index or the work tree differs from the target
+            if (int err = git_diff_tree_to_index(&raw_diff, repo_.get(), target.ptr(), nullptr, &diff_opts))
+                return err;
+            diff_ptr to_index(raw_diff);
+            collect_updates(to_index.get(), false, writes, removes);
+
+            if (int err = git_diff_tree_to_workdir_with_index(&raw_diff, repo_.get(), target.ptr(), &diff_opts))
+                return err;
+            diff_ptr to_workdir(raw_diff);
+            collect_updates(to_workdir.get(), false, writes, removes);
+        }
+        else
+        {
+            // only what changes between the baseline and the target
+            Tree head_tree;
+            git_tree * baseline = options.baseline;
+            if (!baseline && !git_repository_head_unborn(repo_.get()))
+            {
+                head_tree = commit_lookup(head().target()).tree();
+                baseline = head_tree.ptr();
+            }
+
+            if (int err = git_diff_tree_to_tree(&raw_diff, repo_.get(), baseline, target.ptr(), &diff_opts))
+                return err;
+            diff_ptr changes(raw_diff);
+            collect_updates(changes.get(), true, writes, removes);
+        }
+
+        std::sort(writes.begin(), writes.end(), [](FileUpdate const & a, FileUpdate const & b) { return a.path < b.path; });
+        writes.erase(std::unique(writes.begin(), writes.end(), [](FileUpdate const & a, FileUpdate const & b) { return a.path == b.path; }),
+                     writes.end());
+        std::sort(removes.begin(), removes.end());
+        removes.erase(std::unique(removes.begin(), removes.end()), removes.end());
+
+        const std::string workdir = this->workdir();
+        for (auto const & path : removes)
+        {
+            auto it = std::lower_bound(writes.begin(), writes.end(), path,
+                                       [](FileUpdate const & file, std::string const & p) { return file.path < p; });
+            if (it == writes.end() || it->path != path)
+                remove_file(workdir, path);
+        }
+
+        ParallelCheckout checkout(repo_.get(), options, writes);
+        if (int err = checkout.make_directories())
+            return err;
+        if (int err = checkout.run(workers))
+            return err;
+
+        if (strategy & GIT_CHECKOUT_DONT_UPDATE_INDEX)
+            return GIT_OK;
+
+        git_index * raw_index;
+        if (int err = git_repository_index(&raw_index, repo_.get()))
+            return err;
+        std::unique_ptr<git_index, IndexDestroy> index(raw_index);
+
+        for (auto const & path : removes)
+            git_index_remove(index.get(), path.c_str(), 0);
+        for (auto & file : writes)
+        {
+            file.stat.id = file.id;
+            file.stat.mode = file.mode;
+            file.stat.path = file.path.c_str();
+            if (int err = git_index_add(index.get(), &file.stat))
+                return err;
+        }
+        return git_index_write(index.get());
+    }
+
+    int Repository::checkout_head(git_checkout_options const & options, unsigned int workers)
+    {
+        return checkout_tree(commit_lookup(head().target()), options, workers);
+    }
+}
@@ -0,0 +1,101 @@
+#include "commit_graph_file.h"
+
+#include <cstring>
+
+namespace git {
+namespace internal
+{
+    bool CommitGraphChunks::parse(unsigned char const * data, size_t size)
+    {
+        using namespace commit_graph;
+
+        if (size < header_size + GIT_OID_RAWSZ || std::memcmp(data, "CGPH", 4) != 0)
+            return false;
+        // version 1, SHA-1 only
+        if (data[4] != 1 || data[5] != 1)
+            return false;
+
+        const size_t chunks = data[6];
+        base_graphs = data[7];
+        if (size < header_size + (chunks + 1) * chunk_entry_size)
+            return false;
+
+        size_t oids_size = 0, commit_data_bytes = 0, bloom_index_size = 0, base_size = 0;
+        for (size_t i = 0; i != chunks; ++i)
+        {
+            unsigned char const * entry = data + header_size + i * chunk_entry_size;
+            const uint64_t offset = read_u64(entry + 4);
+            const uint64_t end = read_u64(entry + 4 + chunk_entry_size);
+            if (offset > end || end > size)
+                return false;
+
+            unsigned char const * chunk = data + offset;
+            const size_t chunk_size = static_cast<size_t>(end - offset);
+            if (!std::memcmp(entry, "OIDF", 4) && chunk_size == fanout_size)
+                fanout = chunk;
+            else if (!std::memcmp(entry, "OIDL", 4))
+            {
+                oids = chunk;
+                oids_size = chunk_size;
+            }
+            else if (!std::memcmp(entry, "CDAT", 4))
+            {
+                commit_data = chunk;
+                commit_data_bytes = chunk_size;
+            }
+            else if (!std::memcmp(entry, "BIDX", 4))
+            {
+                bloom_index = chunk;
+                bloom_index_size = chunk_size;
+            }
+            else if (!std::memcmp(entry, "BDAT", 4))
+            {
+                if (chunk_size < bloom_header_size)
+                    return false;
+                bloom_data = chunk;
+                bloom_data_size = chunk_size;
+            }
+            else if (!std::memcmp(entry, "BASE", 4))
+            {
+                base = chunk;
+                base_size = chunk_size;
+            }
+        }
+        if (!fanout || !oids || !commit_data)
+            return false;
+
+        for (size_t i = 1; i != 256; ++i)
+        {
+            if (read_u32(fanout + i * 4) < read_u32(fanout + (i - 1) * 4))
+                return false;
+        }
+        commits = read_u32(fanout + fanout_size - 4);
+        if (oids_size != size_t(commits) * GIT_OID_RAWSZ || commit_data_bytes != size_t(commits) * commit_data_size)
+            return false;
+        if (bloom_index && bloom_index_size != size_t(commits) * 4)
+            return false;
+        return base_size == size_t(base_graphs) * GIT_OID_RAWSZ && (base || !base_graphs);
+    }
+
+    bool CommitGraphChunks::find(git_oid const & id, uint32_t & pos) const
+    {
+        const unsigned char first = id.id[0];
+        uint32_t lo = first ? read_u32(fanout + (first - 1) * 4) : 0;
+        uint32_t hi = read_u32(fanout + first * 4);
+        while (lo < hi)
+        {
+            const uint32_t mid = lo + (hi - lo) / 2;
+            const int cmp = std::memcmp(oids + size_t(mid) * GIT_OID_RAWSZ, id.id, GIT_OID_RAWSZ);
+            if (cmp == 0)
+            {
+                pos = mid;
+                return true;
+            }
+            if (cmp < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return false;
+    }
+}}
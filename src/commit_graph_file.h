@@ -0,0 +1,114 @@
+#pragma once
+
+#include <git2/oid.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace git {
+namespace internal
+{
+    namespace commit_graph
+    {
+        const size_t header_size = 8;
+        const size_t chunk_entry_size = 12;
+        const size_t fanout_size = 256 * 4;
+        const size_t commit_data_size = GIT_OID_RAWSZ + 16;
+        const size_t bloom_header_size = 12;
+
+        const uint32_t parent_none = 0x70000000;
+        const uint32_t extra_edges = 0x80000000;    ///< second parent field of an octopus merge, and last edge
+        const uint32_t max_level = 0x3fffffff;
+
+        const uint32_t bloom_seed0 = 0x293ae76f;
+        const uint32_t bloom_seed1 = 0x7e646e2c;
+        const uint32_t bloom_hashes = 7;
+        const uint32_t bloom_bits_per_entry = 10;
+        const size_t bloom_max_paths = 512;
+    }
+
+    inline uint32_t read_u32(unsigned char const * p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    inline uint64_t read_u64(unsigned char const * p)
+    {
+        return (uint64_t(read_u32(p)) << 32) | read_u32(p + 4);
+    }
+
+    /// murmur3 as used by git's changed-path filters: version 1 filters were built
+    /// with sign-extended bytes (`Byte` = signed char), version 2 fixed that
+    template <typename Byte>
+    uint32_t murmur3(uint32_t seed, std::string_view data)
+    {
+        const uint32_t c1 = 0xcc9e2d51;
+        const uint32_t c2 = 0x1b873593;
+
+        auto rotate_left = [](uint32_t value, int count) { return (value << count) | (value >> (32 - count)); };
+        auto byte = [&](size_t i) { return static_cast<uint32_t>(static_cast<Byte>(data[i])); };
+
+        const size_t len4 = data.size() / 4;
+        for (size_t i = 0; i != len4; ++i)
+        {
+            uint32_t k = byte(4 * i) | (byte(4 * i + 1) << 8) | (byte(4 * i + 2) << 16) | (byte(4 * i + 3) << 24);
+            k *= c1;
+            k = rotate_left(k, 15);
+            k *= c2;
+            seed ^= k;
+            seed = rotate_left(seed, 13) * 5 + 0xe6546b64;
+        }
+
+        uint32_t k1 = 0;
+        const size_t tail = len4 * 4;
+        switch (data.size() & 3)
+        {
+        case 3:
+            k1 ^= byte(tail + 2) << 16;
+            // fallthrough
+        case 2:
+            k1 ^= byte(tail + 1) << 8;
+            // fallthrough
+        case 1:
+            k1 ^= byte(tail);
+            k1 *= c1;
+            k1 = rotate_left(k1, 15);
+            k1 *= c2;
+            seed ^= k1;
+            break;
+        }
+
+        seed ^= static_cast<uint32_t>(data.size());
+        seed ^= seed >> 16;
+        seed *= 0x85ebca6b;
+        seed ^= seed >> 13;
+        seed *= 0xc2b2ae35;
+        seed ^= seed >> 16;
+        return seed;
+    }
+
+    /// Chunks of one commit-graph file (version 1, SHA-1). parse() checks them against
+    /// the file size and the fanout, so lookups can trust them.
+    struct CommitGraphChunks
+    {
+        unsigned char const * fanout = nullptr;
+        unsigned char const * oids = nullptr;
+        unsigned char const * commit_data = nullptr;
+        unsigned char const * bloom_index = nullptr;      ///< optional
+        unsigned char const * bloom_data = nullptr;       ///< optional, starts with the BDAT header
+        size_t bloom_data_size = 0;
+        unsigned char const * base = nullptr;             ///< hashes of the base graphs of a chain layer
+        uint32_t commits = 0;
+        uint32_t base_graphs = 0;
+
+        bool parse(unsigned char const * data, size_t size);
+
+        /// @return false if the commit is not in this file
+        bool find(git_oid const &, uint32_t & pos) const;
+
+        unsigned char const * commit(uint32_t pos) const { return commit_data + size_t(pos) * commit_graph::commit_data_size; }
+        /// Topological level of the commit at pos
+        uint32_t level(uint32_t pos) const { return read_u32(commit(pos) + GIT_OID_RAWSZ + 8) >> 2; }
+    };
+}}
@@ -0,0 +1,632 @@
+#include "git2cpp/repo.h"
+#include "git2cpp/id_to_str.h"
+
+#include "commit_graph_file.h"
+#include "file_mapping.h"
+#include "sha1.h"
+
+#include <git2/commit.h>
+#include <git2/errors.h>
+#include <git2/repository.h>
+#include <git2/revwalk.h>
+#include <git2/tree.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace git
+{
+    namespace
+    {
+        namespace cg = internal::commit_graph;
+        namespace fs = std::filesystem;
+
+        int set_error(int error_class, std::string const & message, int error = GIT_ERROR)
+        {
+            git_error_set_str(error_class, message.c_str());
+            return error;
+        }
+
+        void put_u32(std::vector<unsigned char> & out, uint32_t value)
+        {
+            for (int shift = 24; shift >= 0; shift -= 8)
+                out.push_back(static_cast<unsigned char>(value >> shift));
+        }
+
+        void put_u64(std::vector<unsigned char> & out, uint64_t value)
+        {
+            put_u32(out, static_cast<uint32_t>(value >> 32));
+            put_u32(out, static_cast<uint32_t>(value));
+        }
+
+        void put_oid(std::vector<unsigned char> & out, git_oid const & id)
+        {
+            out.insert(out.end(), id.id, id.id + GIT_OID_RAWSZ);
+        }
+
+        bool oid_less(git_oid const & a, git_oid const & b)
+        {
+            return git_oid_cmp(&a, &b) < 0;
+        }
+
+        struct TreeDestroy
+        {
+            void operator()(git_tree * tree) const { git_tree_free(tree); }
+        };
+        typedef std::unique_ptr<git_tree, TreeDestroy> tree_ptr;
+
+        /// Layer of an existing commit-graph chain
+        struct Layer
+        {
+            std::string hash;
+            std::unique_ptr<internal::FileMapping> file;
+            internal::CommitGraphChunks chunks;
+            uint32_t first_position = 0;    ///< position of its first commit in the whole chain
+        };
+
+        int load_chain(fs::path const & graphs_dir, std::vector<Layer> & layers)
+        {
+            std::ifstream chain(graphs_dir / "commit-graph-chain");
+            std::string hash;
+            uint32_t position = 0;
+            while (chain >> hash)
+            {
+                Layer layer;
+                const fs::path path = graphs_dir / ("graph-" + hash + ".graph");
+                layer.file.reset(new internal::FileMapping(path.string().c_str()));
+                if (!*layer.file || !layer.chunks.parse(layer.file->data(), layer.file->size())
+                    || layer.chunks.base_graphs != layers.size())
+                    return set_error(GIT_ERROR_ODB, "invalid commit-graph chain layer '" + path.string() + "'");
+                layer.hash = std::move(hash);
+                layer.first_position = position;
+                position += layer.chunks.commits;
+                layers.push_back(std::move(layer));
+            }
+            return 0;
+        }
+
+        /// Commits reachable from references and HEAD, like `--reachable`
+        int reachable_commits(git_repository * repo, std::vector<git_oid> & res)
+        {
+            git_revwalk * walker;
+            if (auto error = git_revwalk_new(&walker, repo))
+                return error;
+            // tags pointing to trees or blobs are skipped by the walker
+            int error = git_revwalk_push_glob(walker, "refs/*");
+            if (error == 0)
+                error = git_revwalk_push_head(walker);
+            if (error == GIT_EUNBORNBRANCH || error == GIT_ENOTFOUND)
+                error = 0;
+
+            git_oid id;
+            while (error == 0 && (error = git_revwalk_next(&id, walker)) == 0)
+                res.push_back(id);
+            git_revwalk_free(walker);
+            return error == GIT_ITEROVER ? 0 : error;
+        }
+
+        struct Entry
+        {
+            git_oid id;
+            git_oid tree;
+            std::vector<git_oid> parents;
+            uint64_t time;
+            uint32_t level = 0;
+        };
+
+        /// Commits of the layer being written, on top of the kept layers of the chain
+        struct Graph
+        {
+            std::vector<Layer> const & layers;
+            std::vector<Entry> entries;     ///< sorted by id
+            uint32_t base_commits = 0;
+
+            bool find_entry(git_oid const & id, size_t & index) const
+            {
+                auto it = std::lower_bound(entries.begin(), entries.end(), id,
+                                           [] (Entry const & e, git_oid const & id) { return oid_less(e.id, id); });
+                if (it == entries.end() || !git_oid_equal(&it->id, &id))
+                    return false;
+                index = it - entries.begin();
+                return true;
+            }
+
+            Layer const * find_in_layers(git_oid const & id, uint32_t & pos) const
+            {
+                for (auto const & layer : layers)
+                {
+                    if (layer.chunks.find(id, pos))
+                        return &layer;
+                }
+                return nullptr;
+            }
+
+            bool position(git_oid const & id, uint32_t & res) const
+            {
+                size_t index;
+                if (find_entry(id, index))
+                {
+                    res = base_commits + static_cast<uint32_t>(index);
+                    return true;
+                }
+                uint32_t pos;
+                if (auto layer = find_in_layers(id, pos))
+                {
+                    res = layer->first_position + pos;
+                    return true;
+                }
+                return false;
+            }
+
+            int compute_levels()
+            {
+                std::vector<size_t> stack;
+                for (size_t i = 0; i != entries.size(); ++i)
+                {
+                    if (entries[i].level)
+                        continue;
+
+                    // parents first, without recursion: histories can be deep
+                    stack.push_back(i);
+                    while (!stack.empty())
+                    {
+                        Entry & e = entries[stack.back()];
+                        uint32_t level = 0;
+                        bool ready = true;
+                        for (auto const & parent : e.parents)
+                        {
+                            size_t index;
+                            uint32_t pos;
+                            if (find_entry(parent, index))
+                            {
+                                if (entries[index].level)
+                                    level = std::max(level, entries[index].level);
+                                else
+                                {
+                                    stack.push_back(index);
+                                    ready = false;
+                                }
+                            }
+                            else if (auto layer = find_in_layers(parent, pos))
+                                level = std::max(level, layer->chunks.level(pos));
+                            else
+                                return set_error(GIT_ERROR_ODB, "parent of commit " + id_to_str(e.id) + " is not reachable");
+                        }
+                        if (!ready)
+                            continue;
+                        e.level = std::min(level + 1, cg::max_level);
+                        stack.pop_back();
+                    }
+                }
+                return 0;
+            }
+
+            /// @return zero id for a root commit
+            git_oid first_parent_tree(Entry const & e, git_repository * repo, int & error) const
+            {
+                git_oid res = {};
+                if (e.parents.empty())
+                    return res;
+
+                size_t index;
+                uint32_t pos;
+                if (find_entry(e.parents[0], index))
+                    return entries[index].tree;
+                if (auto layer = find_in_layers(e.parents[0], pos))
+                {
+                    git_oid_fromraw(&res, layer->chunks.commit(pos));
+                    return res;
+                }
+
+                git_commit * parent;
+                if ((error = git_commit_lookup(&parent, repo, &e.parents[0])) == 0)
+                {
+                    res = *git_commit_tree_id(parent);
+                    git_commit_free(parent);
+                }
+                return res;
+            }
+        };
+
+        /// Paths that differ between two trees as in git's recursive tree diff, and their
+        /// leading directories; stops looking once too many entries differ
+        struct ChangedPaths
+        {
+            git_repository * repo;
+            std::unordered_set<std::string> paths;
+            size_t changes = 0;
+
+            bool too_many() const { return changes > cg::bloom_max_paths || paths.size() > cg::bloom_max_paths; }
+
+            void add(std::string_view path)
+            {
+                ++changes;
+                for (;;)
+                {
+                    paths.emplace(path);
+                    const size_t slash = path.rfind('/');
+                    if (slash == std::string_view::npos)
+                        break;
+                    path = path.substr(0, slash);
+                }
+            }
+
+            int lookup(git_tree_entry const * entry, tree_ptr & res)
+            {
+                git_tree * tree;
+                if (auto error = git_tree_lookup(&tree, repo, git_tree_entry_id(entry)))
+                    return error;
+                res.reset(tree);
+                return 0;
+            }
+
+            int one_side(git_tree_entry const * entry, std::string const & prefix)
+            {
+                const std::string path = prefix + git_tree_entry_name(entry);
+                if (git_tree_entry_type(entry) != GIT_OBJECT_TREE)
+                {
+                    add(path);
+                    return 0;
+                }
+                tree_ptr tree;
+                if (auto error = lookup(entry, tree))
+                    return error;
+                return compare(nullptr, tree.get(), path + '/');
+            }
+
+            /// Either tree may be null for an empty one
+            int compare(git_tree const * a, git_tree const * b, std::string const & prefix)
+            {
+                const size_t a_count = a ? git_tree_entrycount(a) : 0;
+                const size_t b_count = b ? git_tree_entrycount(b) : 0;
+                size_t i = 0, j = 0;
+                while ((i != a_count || j != b_count) && !too_many())
+                {
+                    git_tree_entry const * ea = i != a_count ? git_tree_entry_byindex(a, i) : nullptr;
+                    git_tree_entry const * eb = j != b_count ? git_tree_entry_byindex(b, j) : nullptr;
+                    // trees sort as if their name ended with '/', so a file and a directory
+                    // of the same name are different entries, as in git
+                    const int cmp = !ea ? 1 : !eb ? -1 : git_tree_entry_cmp(ea, eb);
+
+                    int error = 0;
+                    if (cmp < 0)
+                        error = one_side(ea, prefix), ++i;
+                    else if (cmp > 0)
+                        error = one_side(eb, prefix), ++j;
+                    else
+                    {
+                        if (!git_oid_equal(git_tree_entry_id(ea), git_tree_entry_id(eb))
+                            || git_tree_entry_filemode(ea) != git_tree_entry_filemode(eb))
+                        {
+                            if (git_tree_entry_type(ea) == GIT_OBJECT_TREE)
+                            {
+                                tree_ptr ta, tb;
+                                error = lookup(ea, ta);
+                                if (error == 0)
+                                    error = lookup(eb, tb);
+                                if (error == 0)
+                                    error = compare(ta.get(), tb.get(), prefix + git_tree_entry_name(ea) + '/');
+                            }
+                            else
+                                add(prefix + git_tree_entry_name(ea));
+                        }
+                        ++i, ++j;
+                    }
+                    if (error)
+                        return error;
+                }
+                return 0;
+            }
+        };
+
+        /// Filter of the paths changed by a commit, as git computes it
+        std::vector<unsigned char> bloom_filter(ChangedPaths const & changed, uint32_t version)
+        {
+            // too large to be useful: all bits set
+            if (changed.too_many())
+                return {0xff};
+
+            std::vector<unsigned char> filter(std::max<size_t>((changed.paths.size() * cg::bloom_bits_per_entry + 7) / 8, 1));
+            const uint64_t bits = uint64_t(filter.size()) * 8;
+            for (auto const & path : changed.paths)
+            {
+                const uint32_t hash0 = version == 1 ? internal::murmur3<signed char>(cg::bloom_seed0, path)
+                                                    : internal::murmur3<unsigned char>(cg::bloom_seed0, path);
+                const uint32_t hash1 = version == 1 ? internal::murmur3<signed char>(cg::bloom_seed1, path)
+                                                    : internal::murmur3<unsigned char>(cg::bloom_seed1, path);
+                for (uint32_t i = 0; i != cg::bloom_hashes; ++i)
+                {
+                    const uint64_t bit = uint32_t(hash0 + i * hash1) % bits;
+                    filter[bit / 8] |= static_cast<unsigned char>(1 << (bit % 8));
+                }
+            }
+            return filter;
+        }
+
+        struct Chunk
+        {
+            const char * id;
+            std::vector<unsigned char> data;
+        };
+
+        /// Whole file with header, chunk table and trailing checksum
+        std::vector<unsigned char> assemble(std::vector<Chunk> const & chunks, size_t base_graphs, unsigned char (&checksum)[20])
+        {
+            std::vector<unsigned char> res = {'C', 'G', 'P', 'H', 1, 1,
+                                              static_cast<unsigned char>(chunks.size()), static_cast<unsigned char>(base_graphs)};
+            uint64_t offset = cg::header_size + (chunks.size() + 1) * cg::chunk_entry_size;
+            for (auto const & chunk : chunks)
+            {
+                res.insert(res.end(), chunk.id, chunk.id + 4);
+                put_u64(res, offset);
+                offset += chunk.data.size();
+            }
+            put_u32(res, 0);
+            put_u64(res, offset);
+            for (auto const & chunk : chunks)
+                res.insert(res.end(), chunk.data.begin(), chunk.data.end());
+
+            internal::Sha1 sha1;
+            sha1.update(res.data(), res.size());
+            sha1.final(checksum);
+            res.insert(res.end(), checksum, checksum + 20);
+            return res;
+        }
+
+        int write_file(fs::path const & path, std::vector<unsigned char> const & data, bool exclusive)
+        {
+            FILE * file = std::fopen(path.string().c_str(), exclusive ? "wbx" : "wb");
+            if (!file)
+            {
+                if (exclusive && fs::exists(path))
+                    return set_error(GIT_ERROR_OS, "could not lock '" + path.string() + "': file exists", GIT_ELOCKED);
+                return set_error(GIT_ERROR_OS, "could not create '" + path.string() + "'");
+            }
+            const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+            if (std::fclose(file) != 0 || !written)
+                return set_error(GIT_ERROR_OS, "could not write '" + path.string() + "'");
+            return 0;
+        }
+
+        int rename_file(fs::path const & from, fs::path const & to)
+        {
+            std::error_code ec;
+            fs::rename(from, to, ec);
+            if (ec)
+            {
+                fs::remove(from, ec);
+                return set_error(GIT_ERROR_OS, "could not rename '" + from.string() + "' to '" + to.string() + "'");
+            }
+            return 0;
+        }
+    }
+
+    int Repository::write_commit_graph(CommitGraphOptions const & opts)
+    {
+        const char * commondir = git_repository_commondir(repo_.get());
+        if (!commondir)
+            return GIT_ENOTFOUND;
+        // commits at the shallow boundary would be stored without their parents, as git refuses to
+        if (git_repository_is_shallow(repo_.get()) == 1)
+            return set_error(GIT_ERROR_INVALID, "commit-graphs are not written for shallow repositories", GIT_EINVALID);
+        if (opts.changed_paths && opts.changed_paths_version != 1 && opts.changed_paths_version != 2)
+            return set_error(GIT_ERROR_INVALID, "unsupported changed-path filter version", GIT_EINVALID);
+
+        const fs::path info_dir = fs::path(commondir) / "objects" / "info";
+        const fs::path graphs_dir = info_dir / "commit-graphs";
+
+        std::vector<Layer> layers;
+        if (opts.split)
+        {
+            if (auto error = load_chain(graphs_dir, layers))
+                return error;
+        }
+
+        std::vector<git_oid> reachable;
+        if (auto error = reachable_commits(repo_.get(), reachable))
+            return error;
+        std::sort(reachable.begin(), reachable.end(), oid_less);
+
+        // as git's default split strategy does, the new layer absorbs the layers
+        // at the top of the chain that are at most twice its size
+        std::vector<git_oid> fresh;
+        auto collect_fresh = [&] (size_t kept)
+        {
+            fresh.clear();
+            for (auto const & id : reachable)
+            {
+                uint32_t pos;
+                if (std::none_of(layers.begin(), layers.begin() + kept, [&] (Layer const & layer) { return layer.chunks.find(id, pos); }))
+                    fresh.push_back(id);
+            }
+        };
+        size_t kept = layers.size();
+        collect_fresh(kept);
+        if (fresh.empty())
+            return 0;
+        while (kept && layers[kept - 1].chunks.commits <= 2 * fresh.size())
+            collect_fresh(--kept);
+
+        std::vector<std::string> replaced;
+        for (size_t i = kept; i != layers.size(); ++i)
+            replaced.push_back(layers[i].hash);
+        layers.resize(kept);
+
+        Graph graph{layers, {}, 0};
+        for (auto const & layer : layers)
+            graph.base_commits += layer.chunks.commits;
+
+        graph.entries.reserve(fresh.size());
+        for (auto const & id : fresh)
+        {
+            git_commit * commit;
+            if (auto error = git_commit_lookup(&commit, repo_.get(), &id))
+                return error;
+            Entry e;
+            e.id = id;
+            e.tree = *git_commit_tree_id(commit);
+            for (unsigned int i = 0, n = git_commit_parentcount(commit); i != n; ++i)
+                e.parents.push_back(*git_commit_parent_id(commit, i));
+            e.time = static_cast<uint64_t>(git_commit_time(commit));
+            git_commit_free(commit);
+            graph.entries.push_back(std::move(e));
+        }
+        if (auto error = graph.compute_levels())
+            return error;
+
+        std::vector<Chunk> chunks;
+
+        Chunk fanout = {"OIDF", {}};
+        Chunk oids = {"OIDL", {}};
+        size_t count = 0;
+        for (unsigned int first = 0; first != 256; ++first)
+        {
+            for (; count != graph.entries.size() && graph.entries[count].id.id[0] == first; ++count)
+                put_oid(oids.data, graph.entries[count].id);
+            put_u32(fanout.data, static_cast<uint32_t>(count));
+        }
+
+        Chunk commit_data = {"CDAT", {}};
+        Chunk edges = {"EDGE", {}};
+        for (auto const & e : graph.entries)
+        {
+            uint32_t parents[2] = {cg::parent_none, cg::parent_none};
+            for (size_t i = 0; i != e.parents.size(); ++i)
+            {
+                uint32_t pos;
+                if (!graph.position(e.parents[i], pos))
+                    return set_error(GIT_ERROR_ODB, "parent of commit " + id_to_str(e.id) + " is not reachable");
+                if (i < 2 && e.parents.size() <= 2)
+                    parents[i] = pos;
+                else if (i == 0)
+                    parents[0] = pos;
+                else
+                {
+                    if (i == 1)
+                        parents[1] = cg::extra_edges | static_cast<uint32_t>(edges.data.size() / 4);
+                    put_u32(edges.data, i + 1 == e.parents.size() ? pos | cg::extra_edges : pos);
+                }
+            }
+
+            put_oid(commit_data.data, e.tree);
+            put_u32(commit_data.data, parents[0]);
+            put_u32(commit_data.data, parents[1]);
+            put_u32(commit_data.data, (e.level << 2) | static_cast<uint32_t>((e.time >> 32) & 3));
+            put_u32(commit_data.data, static_cast<uint32_t>(e.time));
+        }
+
+        chunks.push_back(std::move(fanout));
+        chunks.push_back(std::move(oids));
+        chunks.push_back(std::move(commit_data));
+        if (!edges.data.empty())
+            chunks.push_back(std::move(edges));
+
+        if (opts.changed_paths)
+        {
+            uint32_t version = opts.changed_paths_version;
+            for (auto const & layer : layers)
+            {
+                if (layer.chunks.bloom_data)
+                    version = internal::read_u32(layer.chunks.bloom_data);
+            }
+
+            Chunk index = {"BIDX", {}};
+            Chunk filters = {"BDAT", {}};
+            put_u32(filters.data, version);
+            put_u32(filters.data, cg::bloom_hashes);
+            put_u32(filters.data, cg::bloom_bits_per_entry);
+            for (auto const & e : graph.entries)
+            {
+                int error = 0;
+                const git_oid parent_tree = graph.first_parent_tree(e, repo_.get(), error);
+                tree_ptr a, b;
+                git_tree * tree;
+                if (error == 0 && !git_oid_is_zero(&parent_tree) && (error = git_tree_lookup(&tree, repo_.get(), &parent_tree)) == 0)
+                    a.reset(tree);
+                if (error == 0 && (error = git_tree_lookup(&tree, repo_.get(), &e.tree)) == 0)
+                    b.reset(tree);
+
+                ChangedPaths changed = {repo_.get(), {}, 0};
+                if (error == 0)
+                    error = changed.compare(a.get(), b.get(), "");
+                if (error)
+                    return error;
+
+                const auto filter = bloom_filter(changed, version);
+                filters.data.insert(filters.data.end(), filter.begin(), filter.end());
+                put_u32(index.data, static_cast<uint32_t>(filters.data.size() - cg::bloom_header_size));
+            }
+            chunks.push_back(std::move(index));
+            chunks.push_back(std::move(filters));
+        }
+
+        if (!layers.empty())
+        {
+            Chunk base = {"BASE", {}};
+            for (auto const & layer : layers)
+            {
+                git_oid id;
+                if (git_oid_fromstr(&id, layer.hash.c_str()))
+                    return set_error(GIT_ERROR_ODB, "invalid commit-graph chain entry '" + layer.hash + "'");
+                put_oid(base.data, id);
+            }
+            chunks.push_back(std::move(base));
+        }
+
+        unsigned char checksum[20];
+        const auto file = assemble(chunks, layers.size(), checksum);
+
+        if (!opts.split)
+        {
+            const fs::path lock = info_dir / "commit-graph.lock";
+            if (auto error = write_file(lock, file, true))
+                return error;
+            return rename_file(lock, info_dir / "commit-graph");
+        }
+
+        std::error_code ec;
+        fs::create_directories(graphs_dir, ec);
+        if (ec)
+            return set_error(GIT_ERROR_OS, "could not create directory '" + graphs_dir.string() + "': " + ec.message());
+
+        const fs::path chain_lock = graphs_dir / "commit-graph-chain.lock";
+        std::string chain;
+        for (auto const & layer : layers)
+            chain += layer.hash + '\n';
+        git_oid hash;
+        git_oid_fromraw(&hash, checksum);
+        const std::string hash_str = id_to_str(hash);
+        chain += hash_str + '\n';
+        if (auto error = write_file(chain_lock, std::vector<unsigned char>(chain.begin(), chain.end()), true))
+            return error;
+
+        const fs::path layer_path = graphs_dir / ("graph-" + hash_str + ".graph");
+        const fs::path layer_tmp = graphs_dir / ("graph-" + hash_str + ".graph.lock");
+        int error = write_file(layer_tmp, file, false);
+        if (error == 0)
+            error = rename_file(layer_tmp, layer_path);
+        if (error == 0)
+            error = rename_file(chain_lock, graphs_dir / "commit-graph-chain");
+        if (error)
+        {
+            fs::remove(chain_lock, ec);
+            return error;
+        }
+
+        // a single file would take precedence over the chain, and replaced layers are no longer referenced
+        fs::remove(info_dir / "commit-graph", ec);
+        for (auto const & hash : replaced)
+        {
+            if (hash != hash_str)
+                fs::remove(graphs_dir / ("graph-" + hash + ".graph"), ec);
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,178 @@
+#include "git2cpp/commit_view.h"
+#include "git2cpp/error.h"
+
+#include <git2/odb.h>
+#include <git2/repository.h>
+#include <algorithm>
+#include <charconv>
+
+namespace git
+{
+    namespace
+    {
+        // header lines with an object id have a fixed size
+        const size_t tree_line = sizeof("tree ") - 1 + GIT_OID_HEXSZ + 1;
+        const size_t parent_prefix = sizeof("parent ") - 1;
+        const size_t parent_line = parent_prefix + GIT_OID_HEXSZ + 1;
+
+        git_oid parse_oid(std::string_view data, size_t pos, git_oid const & commit)
+        {
+            git_oid res;
+            if (git_oid_fromstrn(&res, data.data() + pos, GIT_OID_HEXSZ))
+                throw commit_lookup_error(commit);
+            return res;
+        }
+
+        bool starts_with(std::string_view data, size_t pos, std::string_view prefix)
+        {
+            return data.compare(pos, prefix.size(), prefix) == 0;
+        }
+
+        // "Name <email> 1234567890 +0100"
+        CommitView::Person parse_person(std::string_view line)
+        {
+            CommitView::Person res = {{}, {}, 0, 0};
+            const size_t open = line.find('<');
+            const size_t close = line.rfind('>');
+            if (open == std::string_view::npos || close == std::string_view::npos || close < open)
+                return res;
+
+            res.name = line.substr(0, open);
+            while (!res.name.empty() && res.name.back() == ' ')
+                res.name.remove_suffix(1);
+            res.email = line.substr(open + 1, close - open - 1);
+
+            std::string_view when = line.substr(close + 1);
+            while (!when.empty() && when.front() == ' ')
+                when.remove_prefix(1);
+            const char * end = std::from_chars(when.data(), when.data() + when.size(), res.time).ptr;
+
+            // " +0100" has to follow the time
+            const std::string_view zone = when.substr(end - when.data());
+            int hhmm;
+            if (end != when.data() && zone.size() >= 6 && zone[0] == ' ' && (zone[1] == '+' || zone[1] == '-')
+                && std::from_chars(zone.data() + 2, zone.data() + 6, hhmm).ptr == zone.data() + 6)
+            {
+                const int minutes = hhmm / 100 * 60 + hhmm % 100;
+                res.offset = zone[1] == '-' ? -minutes : minutes;
+            }
+            return res;
+        }
+
+        std::string_view line_at(std::string_view data, size_t pos)
+        {
+            const size_t end = data.find('\n', pos);
+            return data.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+        }
+    }
+
+    bool ShallowGrafts::contains(git_oid const & id) const
+    {
+        return std::binary_search(ids.begin(), ids.end(), id,
+                                  [](git_oid const & a, git_oid const & b) { return git_oid_cmp(&a, &b) < 0; });
+    }
+
+    void CommitView::Destroy::operator()(git_odb_object * obj) const
+    {
+        git_odb_object_free(obj);
+    }
+
+    CommitView::CommitView(git_repository * repo, git_oid const & id, ShallowGrafts const & shallow)
+        : id_(id)
+    {
+        git_odb * odb;
+        if (git_repository_odb(&odb, repo))
+            throw commit_lookup_error(id);
+        git_odb_object * obj;
+        const int error = git_odb_read(&obj, odb, &id);
+        git_odb_free(odb);
+        if (error)
+            throw commit_lookup_error(id);
+        obj_.reset(obj);
+
+        const std::string_view raw = data();
+        if (git_odb_object_type(obj) != GIT_OBJECT_COMMIT || raw.size() < tree_line || !starts_with(raw, 0, "tree "))
+            throw commit_lookup_error(id);
+
+        for (size_t pos = tree_line; raw.size() >= pos + parent_line && starts_with(raw, pos, "parent "); pos += parent_line)
+            ++parents_num_;
+        parents_end_ = tree_line + parents_num_ * parent_line;
+
+        // commits at a shallow boundary are grafted to have no parents
+        if (parents_num_ && shallow.contains(id))
+            parents_num_ = 0;
+    }
+
+    std::string_view CommitView::data() const
+    {
+        return {static_cast<const char *>(git_odb_object_data(obj_.get())), git_odb_object_size(obj_.get())};
+    }
+
+    git_oid CommitView::tree_id() const
+    {
+        return parse_oid(data(), sizeof("tree ") - 1, id_);
+    }
+
+    git_oid CommitView::parent_id(size_t i) const
+    {
+        return parse_oid(data(), tree_line + i * parent_line + parent_prefix, id_);
+    }
+
+    void CommitView::scan() const
+    {
+        if (scanned_)
+            return;
+
+        const std::string_view raw = data();
+        size_t pos = parents_end_;
+        message_ = raw.size();
+        while (pos < raw.size())
+        {
+            if (raw[pos] == '\n')
+            {
+                message_ = pos + 1;
+                break;
+            }
+            if (!author_ && starts_with(raw, pos, "author "))
+                author_ = pos + sizeof("author ") - 1;
+            else if (!commiter_ && starts_with(raw, pos, "committer "))
+                commiter_ = pos + sizeof("committer ") - 1;
+
+            // continuation lines of multi-line headers (gpgsig) start with a space and are skipped as well
+            const size_t eol = raw.find('\n', pos);
+            pos = eol == std::string_view::npos ? raw.size() : eol + 1;
+        }
+        scanned_ = true;
+    }
+
+    CommitView::Person CommitView::author() const
+    {
+        scan();
+        return author_ ? parse_person(line_at(data(), author_)) : Person{{}, {}, 0, 0};
+    }
+
+    CommitView::Person CommitView::commiter() const
+    {
+        scan();
+        return commiter_ ? parse_person(line_at(data(), commiter_)) : Person{{}, {}, 0, 0};
+    }
+
+    git_time_t CommitView::time() const
+    {
+        return commiter().time;
+    }
+
+    std::string_view CommitView::message() const
+    {
+        scan();
+        return data().substr(message_);
+    }
+
+    std::string_view CommitView::summary() const
+    {
+        std::string_view msg = message();
+        while (!msg.empty() && (msg.front() == '\n' || msg.front() == ' '))
+            msg.remove_prefix(1);
+        return line_at(msg, 0);
+    }
+}
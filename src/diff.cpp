@@ -1,6 +1,8 @@
 #include "git2cpp/diff.h"
 #include "git2cpp/error.h"
 
+#include "metrics_span.h"
+
 #include <cassert>
 
 #ifdef USE_BOOST
@@ -81,6 +83,7 @@ namespace git
 
     void Diff::print(diff::format f, print_callback_t print_callback) const
     {
+        internal::Span span(metrics::Operation::diff_print);
         git_diff_print(diff_.get(), convert(f), &apply_callback, &print_callback);
     }
 
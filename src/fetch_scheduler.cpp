@@ -0,0 +1,245 @@
+#include "git2cpp/fetch_scheduler.h"
+#include "git2cpp/error.h"
+#include "git2cpp/repo.h"
+
+#include <git2/errors.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace git
+{
+    namespace
+    {
+        /// "scheme://[user@]host[:port]/path" or scp-like "[user@]host:path"; empty for local paths
+        std::string host_of(const char * url)
+        {
+            std::string const s = url ? url : "";
+            size_t begin;
+            size_t const scheme = s.find("://");
+            if (scheme != std::string::npos)
+            {
+                if (s.compare(0, scheme, "file") == 0)
+                    return {};
+                begin = scheme + 3;
+            }
+            else
+            {
+                size_t const colon = s.find(':');
+                if (colon == std::string::npos || s.find('/') < colon || colon == 1)
+                    return {};  // local path, or a drive letter
+                begin = 0;
+            }
+
+            size_t const end = s.find_first_of(scheme != std::string::npos ? ":/" : ":", begin);
+            size_t const at = s.rfind('@', end);
+            if (at != std::string::npos && at >= begin)
+                begin = at + 1;
+            return s.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        }
+
+        struct JobCallbacks final : Remote::FetchCallbacks
+        {
+            JobCallbacks(FetchScheduler::Sink & sink, FetchScheduler::Job const & job)
+                : sink_(sink)
+                , job_(job)
+            {}
+
+            void sideband_progress(char const * str, int len) override
+            {
+                sink_.sideband_progress(job_, str, len);
+            }
+
+            void transfer_rate(Remote::TransferRate const & rate) override
+            {
+                sink_.transfer_rate(job_, rate);
+            }
+
+            git_credential* acquire_cred(const char * url, const char * username_from_url, unsigned int allowed_types) override
+            {
+                return sink_.acquire_cred(job_, url, username_from_url, allowed_types);
+            }
+
+        private:
+            FetchScheduler::Sink & sink_;
+            FetchScheduler::Job const & job_;
+        };
+
+        /// Runs a function when leaving the scope
+        template <class F>
+        struct ScopeExit
+        {
+            explicit ScopeExit(F f)
+                : f_(std::move(f))
+            {}
+            ~ScopeExit() { f_(); }
+
+            ScopeExit(ScopeExit const &) = delete;
+            ScopeExit & operator=(ScopeExit const &) = delete;
+
+        private:
+            F f_;
+        };
+
+        std::string last_error_message(int error)
+        {
+            if (auto err = git_error_last())
+                return err->message;
+            return "fetch failed with error " + std::to_string(error);
+        }
+    }
+
+    FetchScheduler::FetchScheduler(unsigned int workers, unsigned int per_host)
+        : workers_(std::max(workers, 1u))
+        , per_host_(std::max(per_host, 1u))
+    {}
+
+    void FetchScheduler::add(std::string repo_path, std::string remote, Remote::FetchOptions options)
+    {
+        Repository repo(repo_path);
+        std::string host = host_of(repo.remote(remote.c_str()).url());
+        jobs_.push_back(Job{ std::move(repo_path), std::move(remote), std::move(host), options });
+    }
+
+    void FetchScheduler::add_all(std::string const & repo_path, Remote::FetchOptions options)
+    {
+        Repository repo(repo_path);
+        auto const remotes = repo.remotes();
+        for (size_t i = 0; i != remotes.count(); ++i)
+        {
+            char const * name = remotes[i];
+            jobs_.push_back(Job{ repo_path, name, host_of(repo.remote(name).url()), options });
+        }
+    }
+
+    size_t FetchScheduler::run(Sink & sink)
+    {
+        std::mutex mutex;
+        std::condition_variable host_released;
+        std::map<std::string, unsigned int> in_flight;
+        std::vector<bool> taken(jobs_.size(), false);
+        size_t remaining = jobs_.size();
+        size_t failed = 0;
+        bool stopped = false;               // no further job is handed out
+        std::exception_ptr sink_error;      // first exception thrown by sink.finished
+
+        // picks the first job whose host has a free slot, waiting for one if all are busy
+        auto next_job = [&] () -> Job const *
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;)
+            {
+                if (remaining == 0 || stopped)
+                    return nullptr;
+                for (size_t i = 0; i != jobs_.size(); ++i)
+                {
+                    if (taken[i])
+                        continue;
+                    if (!jobs_[i].host.empty())
+                    {
+                        auto & count = in_flight[jobs_[i].host];
+                        if (count == per_host_)
+                            continue;
+                        ++count;
+                    }
+                    taken[i] = true;
+                    --remaining;
+                    return &jobs_[i];
+                }
+                host_released.wait(lock);
+            }
+        };
+
+        auto stop = [&]
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopped = true;
+            }
+            host_released.notify_all();
+        };
+
+        auto worker = [&]
+        {
+            while (Job const * job = next_job())
+            {
+                Result result{ *job, {}, {} };
+                {
+                    // the host slot is given back however the job ends
+                    ScopeExit release([&]
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if (!job->host.empty())
+                                --in_flight[job->host];
+                            if (!result.error.empty())
+                                ++failed;
+                        }
+                        host_released.notify_all();
+                    });
+
+                    try
+                    {
+                        sink.started(*job);
+                        Repository repo(job->repo_path);
+                        JobCallbacks callbacks(sink, *job);
+                        result.stats = repo.remote(job->remote.c_str()).fetch(callbacks, job->options);
+                        if (result.stats.error != 0)
+                            result.error = last_error_message(result.stats.error);
+                    }
+                    catch (std::exception const & e)
+                    {
+                        result.error = e.what();
+                    }
+                    catch (...)
+                    {
+                        result.error = "fetch failed with an unknown exception";
+                    }
+                }
+
+                // exceptions must not escape the thread: the calling one rethrows them
+                try
+                {
+                    sink.finished(result);
+                }
+                catch (...)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!sink_error)
+                            sink_error = std::current_exception();
+                    }
+                    stop();
+                    return;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        const size_t count = std::min<size_t>(workers_, jobs_.size());
+        try
+        {
+            threads.reserve(count);
+            for (size_t i = 0; i != count; ++i)
+                threads.emplace_back(worker);
+        }
+        catch (...)
+        {
+            stop();
+            for (auto & thread : threads)
+                thread.join();
+            throw;
+        }
+        for (auto & thread : threads)
+            thread.join();
+
+        if (sink_error)
+            std::rethrow_exception(sink_error);
+        return failed;
+    }
+}
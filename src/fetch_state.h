@@ -0,0 +1,30 @@
+#pragma once
+
+#include "git2cpp/remote.h"
+
+#include <git2/remote.h>
+
+#include <chrono>
+
+namespace git {
+namespace internal
+{
+    /// Payload given to libgit2 for the duration of one fetch (or clone)
+    struct FetchState
+    {
+        explicit FetchState(Remote::FetchCallbacks & callbacks);
+
+        Remote::FetchCallbacks & callbacks;
+
+        Remote::TransferRate transfer_rate(git_indexer_progress const &);
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        Remote::TransferRate::Phase phase_ = Remote::TransferRate::Phase::receiving;
+        clock::time_point phase_start_;
+        unsigned int done_at_phase_start_ = 0;
+    };
+
+    git_fetch_options fetch_options(FetchState &, Remote::FetchOptions const & = {});
+}}
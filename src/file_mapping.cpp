@@ -0,0 +1,85 @@
+#include "file_mapping.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace git {
+namespace internal
+{
+#ifdef _WIN32
+    FileMapping::FileMapping(const char * path)
+    {
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+        file_ = file;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+            return;
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0)
+        {
+            valid_ = true;
+            return;
+        }
+
+        mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_)
+            return;
+        data_ = static_cast<unsigned char const *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        valid_ = data_ != nullptr;
+    }
+
+    FileMapping::~FileMapping()
+    {
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        if (file_)
+            CloseHandle(file_);
+    }
+#else
+    FileMapping::FileMapping(const char * path)
+    {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+        {
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ == 0)
+            {
+                valid_ = true;
+            }
+            else
+            {
+                void * data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    data_ = static_cast<unsigned char const *>(data);
+                    valid_ = true;
+                }
+            }
+        }
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+    }
+
+    FileMapping::~FileMapping()
+    {
+        if (data_)
+            ::munmap(const_cast<unsigned char *>(data_), size_);
+    }
+#endif
+}}
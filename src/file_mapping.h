@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+namespace git {
+namespace internal
+{
+    /// Whole file mapped read-only into memory
+    struct FileMapping
+    {
+        explicit FileMapping(const char * path);
+        ~FileMapping();
+
+        FileMapping(FileMapping const &) = delete;
+        FileMapping & operator=(FileMapping const &) = delete;
+
+        /// false if the file could not be opened or mapped
+        explicit operator bool() const { return valid_; }
+
+        unsigned char const * data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        unsigned char const * data_ = nullptr;
+        size_t size_ = 0;
+        bool valid_ = false;
+#ifdef _WIN32
+        void * file_ = nullptr;
+        void * mapping_ = nullptr;
+#endif
+    };
+}}
@@ -1,4 +1,6 @@
 #include <cassert>
+#include <cctype>
+#include <cstring>
 
 #include <git2/index.h>
 #include <git2/repository.h>
@@ -45,6 +47,43 @@ namespace git
         return git_index_get_bypath(index_.get(), path, stage);
     }
 
+    namespace
+    {
+        bool has_prefix(const char * path, const char * prefix, size_t prefix_len, bool ignore_case)
+        {
+            if (!ignore_case)
+                return std::strncmp(path, prefix, prefix_len) == 0;
+
+            for (size_t i = 0; i != prefix_len; ++i)
+            {
+                if (std::tolower(static_cast<unsigned char>(path[i])) != std::tolower(static_cast<unsigned char>(prefix[i])))
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    std::pair<size_t, size_t> Index::prefix_range(const char * prefix) const
+    {
+        size_t first;
+        if (git_index_find_prefix(&first, index_.get(), prefix) != 0)
+            return {0, 0};
+
+        // entries are kept sorted by path, so the matching ones are contiguous
+        const size_t prefix_len = std::strlen(prefix);
+        const bool ignore_case = (git_index_caps(index_.get()) & GIT_INDEX_CAPABILITY_IGNORE_CASE) != 0;
+        size_t lo = first + 1, hi = entrycount();
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (has_prefix((*this)[mid]->path, prefix, prefix_len, ignore_case))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return {first, lo};
+    }
+
     namespace
     {
         int apply_callback(const char * path, const char * matched_pathspec, void * payload)
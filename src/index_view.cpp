@@ -0,0 +1,227 @@
+#include "git2cpp/index_view.h"
+#include "git2cpp/error.h"
+
+#include "file_mapping.h"
+
+#include <cstring>
+
+namespace git
+{
+    namespace
+    {
+        // fixed-size part of an on-disk entry: stat data, oid and flags
+        const size_t entry_header_size = 62;
+        const size_t extended_flags_size = 2;
+        const size_t checksum_size = 20;
+
+        uint32_t read_u32(unsigned char const * p)
+        {
+            return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+
+        uint16_t read_u16(unsigned char const * p)
+        {
+            return static_cast<uint16_t>((p[0] << 8) | p[1]);
+        }
+
+        size_t entry_path_offset(unsigned int version, uint16_t flags)
+        {
+            return (version >= 3 && (flags & GIT_INDEX_ENTRY_EXTENDED))
+                       ? entry_header_size + extended_flags_size
+                       : entry_header_size;
+        }
+
+        // offset varint used by index version 4
+        bool read_varint(unsigned char const *& p, unsigned char const * end, size_t & value)
+        {
+            if (p == end)
+                return false;
+            unsigned char c = *p++;
+            value = c & 0x7f;
+            while (c & 0x80)
+            {
+                if (p == end)
+                    return false;
+                c = *p++;
+                value = ((value + 1) << 7) | (c & 0x7f);
+            }
+            return true;
+        }
+    }
+
+    void IndexView::Destroy::operator()(internal::FileMapping * file) const
+    {
+        delete file;
+    }
+
+    IndexView::IndexView(const char * index_path)
+        : file_(new internal::FileMapping(index_path))
+    {
+        if (!*file_ || file_->size() < 12 + checksum_size)
+            throw index_open_error();
+
+        unsigned char const * const data = file_->data();
+        if (std::memcmp(data, "DIRC", 4) != 0)
+            throw index_open_error();
+
+        version_ = read_u32(data + 4);
+        if (version_ < 2 || version_ > 4)
+            throw index_open_error();
+
+        const size_t count = read_u32(data + 8);
+        offsets_.reserve(count);
+        if (version_ == 4)
+            path_offsets_.reserve(count);
+
+        unsigned char const * const end = data + file_->size() - checksum_size;
+        unsigned char const * p = data + 12;
+        size_t prev_path = 0, prev_len = 0;
+        for (size_t i = 0; i != count; ++i)
+        {
+            if (static_cast<size_t>(end - p) < entry_header_size)
+                throw index_open_error();
+
+            const uint16_t entry_flags = read_u16(p + entry_header_size - 2);
+            unsigned char const * name = p + entry_path_offset(version_, entry_flags);
+            if (name >= end)
+                throw index_open_error();
+
+            offsets_.push_back(static_cast<size_t>(p - data));
+
+            if (version_ == 4)
+            {
+                size_t strip;
+                if (!read_varint(name, end, strip) || strip > prev_len)
+                    throw index_open_error();
+                auto suffix_end = static_cast<unsigned char const *>(std::memchr(name, 0, end - name));
+                if (!suffix_end)
+                    throw index_open_error();
+
+                const size_t keep = prev_len - strip;
+                const size_t path_start = paths_.size();
+                paths_.resize(path_start + keep);
+                std::memcpy(paths_.data() + path_start, paths_.data() + prev_path, keep);
+                paths_.insert(paths_.end(), name, suffix_end + 1);
+
+                path_offsets_.push_back(path_start);
+                prev_path = path_start;
+                prev_len = keep + (suffix_end - name);
+                p = suffix_end + 1;
+            }
+            else
+            {
+                size_t len = entry_flags & GIT_INDEX_ENTRY_NAMEMASK;
+                if (len == GIT_INDEX_ENTRY_NAMEMASK)
+                {
+                    auto nul = static_cast<unsigned char const *>(std::memchr(name, 0, end - name));
+                    if (!nul)
+                        throw index_open_error();
+                    len = nul - name;
+                }
+                // path is NUL-padded to a multiple of 8 bytes
+                const size_t entry_size = (name - p + len + 8) & ~size_t(7);
+                if (static_cast<size_t>(end - p) < entry_size || name[len] != '\0')
+                    throw index_open_error();
+                p += entry_size;
+            }
+        }
+
+        // a split index keeps part of its entries in a shared index, which is not read
+        while (static_cast<size_t>(end - p) >= 8)
+        {
+            const size_t size = read_u32(p + 4);
+            if (std::memcmp(p, "link", 4) == 0 || static_cast<size_t>(end - p) - 8 < size)
+                throw index_open_error();
+            p += 8 + size;
+        }
+    }
+
+    uint16_t IndexView::flags(size_t i) const
+    {
+        return read_u16(file_->data() + offsets_[i] + entry_header_size - 2);
+    }
+
+    const char * IndexView::path(size_t i) const
+    {
+        if (version_ == 4)
+            return paths_.data() + path_offsets_[i];
+
+        unsigned char const * entry = file_->data() + offsets_[i];
+        return reinterpret_cast<const char *>(entry + entry_path_offset(version_, flags(i)));
+    }
+
+    git_index_entry IndexView::operator[](size_t i) const
+    {
+        unsigned char const * p = file_->data() + offsets_[i];
+
+        git_index_entry res;
+        res.ctime.seconds = static_cast<int32_t>(read_u32(p));
+        res.ctime.nanoseconds = read_u32(p + 4);
+        res.mtime.seconds = static_cast<int32_t>(read_u32(p + 8));
+        res.mtime.nanoseconds = read_u32(p + 12);
+        res.dev = read_u32(p + 16);
+        res.ino = read_u32(p + 20);
+        res.mode = read_u32(p + 24);
+        res.uid = read_u32(p + 28);
+        res.gid = read_u32(p + 32);
+        res.file_size = read_u32(p + 36);
+        std::memcpy(res.id.id, p + 40, GIT_OID_RAWSZ);
+        res.flags = read_u16(p + 60);
+        res.flags_extended = entry_path_offset(version_, res.flags) != entry_header_size
+                                 ? read_u16(p + entry_header_size)
+                                 : 0;
+        res.path = path(i);
+        return res;
+    }
+
+    internal::optional<git_index_entry> IndexView::get_by_path(const char * path, int stage) const
+    {
+        // entries are sorted by path, then by stage
+        size_t lo = 0, hi = entrycount();
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            int cmp = std::strcmp(this->path(mid), path);
+            if (cmp == 0)
+                cmp = ((flags(mid) & GIT_INDEX_ENTRY_STAGEMASK) >> GIT_INDEX_ENTRY_STAGESHIFT) - stage;
+            if (cmp < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if (lo == entrycount() || std::strcmp(this->path(lo), path) != 0)
+            return internal::none;
+        if (stage != GIT_INDEX_STAGE_ANY
+            && ((flags(lo) & GIT_INDEX_ENTRY_STAGEMASK) >> GIT_INDEX_ENTRY_STAGESHIFT) != stage)
+            return internal::none;
+        return (*this)[lo];
+    }
+
+    std::pair<size_t, size_t> IndexView::prefix_range(const char * prefix) const
+    {
+        const size_t prefix_len = std::strlen(prefix);
+
+        size_t lo = 0, hi = entrycount();
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (std::strncmp(path(mid), prefix, prefix_len) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        const size_t first = lo;
+
+        hi = entrycount();
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (std::strncmp(path(mid), prefix, prefix_len) == 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return {first, lo};
+    }
+}
@@ -1,5 +1,7 @@
 #include "git2cpp/initializer.h"
 
+#include "reftable.h"
+
 #include <git2/global.h>
 
 namespace git
@@ -7,6 +9,7 @@ namespace git
     Initializer::Initializer()
     {
         git_libgit2_init();
+        internal::reftable::allow_ref_storage_extension();
     }
 
     Initializer::~Initializer()
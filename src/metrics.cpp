@@ -0,0 +1,239 @@
+#include "git2cpp/metrics.h"
+
+#include "metrics_span.h"
+
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace git
+{
+    namespace internal
+    {
+        std::atomic<unsigned> instrumentation(0);
+    }
+
+    namespace metrics
+    {
+        namespace
+        {
+            const unsigned metrics_bit = 1;
+            const unsigned trace_bit = 2;
+
+            struct Counters
+            {
+                std::atomic<uint64_t> count;
+                std::atomic<uint64_t> total_ns;
+                std::atomic<uint64_t> max_ns;
+                std::array<std::atomic<uint64_t>, Latency::buckets> histogram;
+            };
+
+            std::array<Counters, operation_count> operations;
+            std::atomic<uint64_t> bytes_inflated;
+            std::atomic<uint64_t> cache_hits;
+            std::atomic<uint64_t> cache_misses;
+
+            size_t bucket(uint64_t ns)
+            {
+                size_t res = 0;
+                for (uint64_t us = ns / 1000; us != 0 && res + 1 != Latency::buckets; us >>= 1)
+                    ++res;
+                return res;
+            }
+
+            struct Event
+            {
+                Operation op;
+                unsigned thread;
+                std::chrono::steady_clock::time_point start;
+                std::chrono::nanoseconds duration;
+            };
+
+            struct Trace
+            {
+                std::mutex mutex;
+                std::vector<Event> events;
+                size_t max_events = 0;
+                std::chrono::steady_clock::time_point start;
+                unsigned next_thread = 0;
+            };
+
+            Trace & trace()
+            {
+                static Trace res;
+                return res;
+            }
+
+            // small stable ids for the trace viewer instead of native thread handles
+            unsigned thread_index(Trace & t)
+            {
+                thread_local unsigned index = 0;
+                if (!index)
+                    index = ++t.next_thread;
+                return index;
+            }
+
+            void record(Latency & to, Counters const & from)
+            {
+                to.count = from.count.load(std::memory_order_relaxed);
+                to.total_ns = from.total_ns.load(std::memory_order_relaxed);
+                to.max_ns = from.max_ns.load(std::memory_order_relaxed);
+                for (size_t i = 0; i != Latency::buckets; ++i)
+                    to.histogram[i] = from.histogram[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        const char * name(Operation op)
+        {
+            switch (op)
+            {
+            case Operation::commit_lookup: return "commit_lookup";
+            case Operation::tree_lookup:   return "tree_lookup";
+            case Operation::blob_lookup:   return "blob_lookup";
+            case Operation::odb_read:      return "odb_read";
+            case Operation::diff:          return "diff";
+            case Operation::diff_print:    return "diff_print";
+            case Operation::status:        return "status";
+            case Operation::blame_file:    return "blame_file";
+            case Operation::fetch:         return "fetch";
+            }
+            return "unknown";
+        }
+
+        void enable(bool on)
+        {
+            if (on)
+                internal::instrumentation.fetch_or(metrics_bit);
+            else
+                internal::instrumentation.fetch_and(~metrics_bit);
+        }
+
+        bool enabled()
+        {
+            return internal::metrics_enabled();
+        }
+
+        double Latency::quantile_us(double q) const
+        {
+            if (!count)
+                return 0;
+            const uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i != buckets; ++i)
+            {
+                seen += histogram[i];
+                if (seen >= rank)
+                    return static_cast<double>(uint64_t(1) << i);
+            }
+            return static_cast<double>(uint64_t(1) << (buckets - 1));
+        }
+
+        double Snapshot::cache_hit_rate() const
+        {
+            const uint64_t lookups = cache_hits + cache_misses;
+            return lookups ? static_cast<double>(cache_hits) / lookups : 0;
+        }
+
+        Snapshot snapshot()
+        {
+            Snapshot res;
+            for (size_t i = 0; i != operation_count; ++i)
+                record(res.operations[i], operations[i]);
+            res.bytes_inflated = bytes_inflated.load(std::memory_order_relaxed);
+            res.cache_hits = cache_hits.load(std::memory_order_relaxed);
+            res.cache_misses = cache_misses.load(std::memory_order_relaxed);
+            return res;
+        }
+
+        void reset()
+        {
+            for (auto & op : operations)
+            {
+                op.count = 0;
+                op.total_ns = 0;
+                op.max_ns = 0;
+                for (auto & b : op.histogram)
+                    b = 0;
+            }
+            bytes_inflated = 0;
+            cache_hits = 0;
+            cache_misses = 0;
+        }
+
+        void start_trace(size_t max_events)
+        {
+            Trace & t = trace();
+            {
+                std::lock_guard<std::mutex> lock(t.mutex);
+                t.events.clear();
+                t.max_events = max_events;
+                t.start = std::chrono::steady_clock::now();
+            }
+            internal::instrumentation.fetch_or(trace_bit);
+        }
+
+        void stop_trace(std::ostream & out)
+        {
+            internal::instrumentation.fetch_and(~trace_bit);
+
+            Trace & t = trace();
+            std::lock_guard<std::mutex> lock(t.mutex);
+            out << "{\"traceEvents\":[";
+            const char * sep = "\n";
+            for (auto const & e : t.events)
+            {
+                // complete events, timestamps in microseconds
+                out << sep << "{\"name\":\"" << name(e.op) << "\",\"cat\":\"git2cpp\",\"ph\":\"X\",\"pid\":1"
+                    << ",\"tid\":" << e.thread
+                    << ",\"ts\":" << std::chrono::duration<double, std::micro>(e.start - t.start).count()
+                    << ",\"dur\":" << std::chrono::duration<double, std::micro>(e.duration).count()
+                    << '}';
+                sep = ",\n";
+            }
+            out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+            t.events.clear();
+            t.events.shrink_to_fit();
+        }
+    }
+
+    namespace internal
+    {
+        void add_inflated(size_t bytes)
+        {
+            metrics::bytes_inflated.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void add_cache_lookup(bool hit)
+        {
+            (hit ? metrics::cache_hits : metrics::cache_misses).fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void Span::finish()
+        {
+            const auto end = std::chrono::steady_clock::now();
+            const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_);
+
+            if (mode_ & metrics::metrics_bit)
+            {
+                const uint64_t ns = duration.count();
+                auto & c = metrics::operations[static_cast<size_t>(op_)];
+                c.count.fetch_add(1, std::memory_order_relaxed);
+                c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+                c.histogram[metrics::bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+                uint64_t max = c.max_ns.load(std::memory_order_relaxed);
+                while (ns > max && !c.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+                {
+                }
+            }
+
+            if (mode_ & metrics::trace_bit)
+            {
+                auto & t = metrics::trace();
+                std::lock_guard<std::mutex> lock(t.mutex);
+                if (t.events.size() < t.max_events)
+                    t.events.push_back({op_, metrics::thread_index(t), start_, duration});
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "git2cpp/metrics.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace git {
+namespace internal
+{
+    /// bit 0: metrics enabled, bit 1: trace recording
+    extern std::atomic<unsigned> instrumentation;
+
+    inline bool metrics_enabled()
+    {
+        return instrumentation.load(std::memory_order_relaxed) & 1;
+    }
+
+    void add_inflated(size_t bytes);
+    void add_cache_lookup(bool hit);
+
+    inline void count_inflated(size_t bytes)
+    {
+        if (metrics_enabled())
+            add_inflated(bytes);
+    }
+
+    inline void count_cache(bool hit)
+    {
+        if (metrics_enabled())
+            add_cache_lookup(hit);
+    }
+
+    /// Measures the enclosing scope as one call of `op`
+    struct Span
+    {
+        explicit Span(metrics::Operation op)
+            : op_(op)
+            , mode_(instrumentation.load(std::memory_order_relaxed))
+        {
+            if (mode_)
+                start_ = std::chrono::steady_clock::now();
+        }
+
+        ~Span()
+        {
+            if (mode_)
+                finish();
+        }
+
+        Span(Span const &) = delete;
+        Span & operator=(Span const &) = delete;
+
+    private:
+        void finish();
+
+    private:
+        metrics::Operation op_;
+        unsigned mode_;
+        std::chrono::steady_clock::time_point start_;
+    };
+}}
@@ -0,0 +1,197 @@
+#include "git2cpp/object_cache.h"
+
+#include <git2/blob.h>
+#include <git2/commit.h>
+#include <git2/object.h>
+#include <git2/tag.h>
+#include <git2/tree.h>
+
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace git
+{
+    namespace
+    {
+        struct OidHash
+        {
+            size_t operator() (git_oid const & oid) const
+            {
+                // the first byte selects the shard, the following ones are as good as random
+                size_t hash;
+                std::memcpy(&hash, oid.id + 1, sizeof(hash));
+                return hash;
+            }
+        };
+
+        struct OidEqual
+        {
+            bool operator() (git_oid const & a, git_oid const & b) const
+            {
+                return git_oid_equal(&a, &b) != 0;
+            }
+        };
+
+        size_t size_of(git_object * obj)
+        {
+            const size_t overhead = 64;
+            switch (git_object_type(obj))
+            {
+            case GIT_OBJECT_BLOB:
+                return overhead + static_cast<size_t>(git_blob_rawsize(reinterpret_cast<git_blob *>(obj)));
+            case GIT_OBJECT_TREE:
+                return overhead + git_tree_entrycount(reinterpret_cast<git_tree *>(obj)) * (sizeof(git_oid) + 32);
+            case GIT_OBJECT_COMMIT:
+            {
+                auto commit = reinterpret_cast<git_commit *>(obj);
+                return overhead + std::strlen(git_commit_raw_header(commit)) + std::strlen(git_commit_message_raw(commit));
+            }
+            case GIT_OBJECT_TAG:
+            {
+                auto message = git_tag_message(reinterpret_cast<git_tag *>(obj));
+                return overhead + (message ? std::strlen(message) : 0);
+            }
+            default:
+                return overhead;
+            }
+        }
+
+        struct Entry
+        {
+            git_object * obj;
+            size_t size;
+        };
+
+        struct Lru
+        {
+            std::list<Entry> entries;   // most recently used first
+            size_t bytes = 0;
+            size_t budget = 0;
+        };
+    }
+
+    struct ObjectCache::Shard
+    {
+        std::mutex mutex;
+        Lru lrus[2];
+        std::unordered_map<git_oid, std::list<Entry>::iterator, OidHash, OidEqual> index;
+        Stats stats;
+
+        Lru & lru_for(git_object_t type)
+        {
+            return lrus[type == GIT_OBJECT_BLOB ? 1 : 0];
+        }
+
+        void evict(Lru & lru)
+        {
+            auto & victim = lru.entries.back();
+            index.erase(*git_object_id(victim.obj));
+            lru.bytes -= victim.size;
+            git_object_free(victim.obj);
+            lru.entries.pop_back();
+            ++stats.evictions;
+        }
+    };
+
+    ObjectCache::ObjectCache()
+        : ObjectCache(Budget())
+    {
+    }
+
+    ObjectCache::ObjectCache(Budget const & budget)
+        : shards_(new Shard[shards_count])
+    {
+        for (size_t i = 0; i != shards_count; ++i)
+        {
+            shards_[i].lrus[0].budget = budget.commits_and_trees / shards_count;
+            shards_[i].lrus[1].budget = budget.blobs / shards_count;
+        }
+    }
+
+    ObjectCache::~ObjectCache()
+    {
+        clear();
+    }
+
+    git_object * ObjectCache::get(git_oid const & oid, git_object_t type)
+    {
+        Shard & shard = shards_[oid.id[0] % shards_count];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.index.find(oid);
+        if (it == shard.index.end() || (type != GIT_OBJECT_ANY && git_object_type(it->second->obj) != type))
+        {
+            ++shard.stats.misses;
+            return nullptr;
+        }
+
+        ++shard.stats.hits;
+        auto & lru = shard.lru_for(git_object_type(it->second->obj));
+        lru.entries.splice(lru.entries.begin(), lru.entries, it->second);
+
+        git_object * res;
+        git_object_dup(&res, it->second->obj);
+        return res;
+    }
+
+    void ObjectCache::put(git_object * obj)
+    {
+        git_oid const & oid = *git_object_id(obj);
+        Shard & shard = shards_[oid.id[0] % shards_count];
+        auto & lru = shard.lru_for(git_object_type(obj));
+        const size_t size = size_of(obj);
+        if (size > lru.budget)
+            return;
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.index.count(oid))
+            return;
+
+        while (lru.bytes + size > lru.budget)
+            shard.evict(lru);
+
+        git_object * copy;
+        git_object_dup(&copy, obj);
+        lru.entries.push_front(Entry{ copy, size });
+        lru.bytes += size;
+        shard.index.emplace(oid, lru.entries.begin());
+    }
+
+    ObjectCache::Stats ObjectCache::stats() const
+    {
+        Stats res;
+        for (size_t i = 0; i != shards_count; ++i)
+        {
+            Shard & shard = shards_[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            res.hits += shard.stats.hits;
+            res.misses += shard.stats.misses;
+            res.evictions += shard.stats.evictions;
+            for (auto const & lru : shard.lrus)
+            {
+                res.objects += lru.entries.size();
+                res.bytes += lru.bytes;
+            }
+        }
+        return res;
+    }
+
+    void ObjectCache::clear()
+    {
+        for (size_t i = 0; i != shards_count; ++i)
+        {
+            Shard & shard = shards_[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto & lru : shard.lrus)
+            {
+                for (auto & entry : lru.entries)
+                    git_object_free(entry.obj);
+                lru.entries.clear();
+                lru.bytes = 0;
+            }
+            shard.index.clear();
+        }
+    }
+}
@@ -1,9 +1,15 @@
 #include <git2/odb.h>
+#include <git2/odb_backend.h>
+#include <git2/pack.h>
 #include <git2/repository.h>
+#include <git2/sys/mempack.h>
+#include <git2/sys/odb_backend.h>
 
 #include "git2cpp/error.h"
 #include "git2cpp/odb.h"
 
+#include "metrics_span.h"
+
 namespace git
 {
     Odb::Odb(git_repository * repo)
@@ -21,9 +27,11 @@ namespace git
 
     OdbObject Odb::read(git_oid const & oid) const
     {
+        internal::Span span(metrics::Operation::odb_read);
         git_odb_object * obj;
         if (git_odb_read(&obj, odb_.get(), &oid))
             throw odb_read_error(oid);
+        internal::count_inflated(git_odb_object_size(obj));
         return OdbObject(obj);
     }
 
@@ -34,4 +42,96 @@ namespace git
             throw odb_write_error();
         return res;
     }
+
+    Odb::BulkWriter Odb::bulk_writer()
+    {
+        return BulkWriter(odb_.get());
+    }
+
+    Odb::BulkWriter::BulkWriter(git_odb * target)
+        : target_(target)
+    {
+        git_odb * odb;
+        if (git_odb_new(&odb))
+            throw odb_open_error();
+        odb_.reset(odb);
+
+        if (git_mempack_new(&mempack_))
+            throw odb_open_error();
+        if (git_odb_add_backend(odb, mempack_, 1))
+        {
+            // the odb only owns backends it has accepted
+            mempack_->free(mempack_);
+            throw odb_open_error();
+        }
+
+        git_repository * repo;
+        if (git_repository_wrap_odb(&repo, odb))
+            throw odb_open_error();
+        repo_.reset(repo);
+    }
+
+    void Odb::BulkWriter::DestroyOdb::operator()(git_odb * odb) const
+    {
+        git_odb_free(odb);
+    }
+
+    void Odb::BulkWriter::DestroyRepository::operator()(git_repository * repo) const
+    {
+        git_repository_free(repo);
+    }
+
+    git_oid Odb::BulkWriter::write(const void * data, size_t len, git_object_t type)
+    {
+        git_oid res;
+        if (git_odb_write(&res, odb_.get(), data, len, type))
+            throw odb_write_error();
+        pending_.push_back(res);
+        pending_bytes_ += len;
+        return res;
+    }
+
+    void Odb::BulkWriter::commit()
+    {
+        if (pending_.empty())
+            return;
+
+        // git_mempack_dump only packs what is reachable from commits, so objects are added one by one
+        git_packbuilder * builder;
+        if (git_packbuilder_new(&builder, repo_.get()))
+            throw odb_write_error();
+        git_packbuilder_set_threads(builder, 0);
+        int error = 0;
+        for (auto const & id : pending_)
+        {
+            if ((error = git_packbuilder_insert(builder, &id, nullptr)) != 0)
+                break;
+        }
+
+        // the pack is streamed into the indexer as it is built, never held in memory as a whole
+        git_odb_writepack * writepack;
+        if (error == 0 && (error = git_odb_write_pack(&writepack, target_, nullptr, nullptr)) == 0)
+        {
+            struct Append
+            {
+                git_odb_writepack * writepack;
+                git_indexer_progress stats;
+            } append = { writepack, {} };
+            error = git_packbuilder_foreach(builder, [] (void * data, size_t size, void * payload)
+            {
+                auto append = static_cast<Append *>(payload);
+                return append->writepack->append(append->writepack, data, size, &append->stats);
+            }, &append);
+            if (error == 0)
+                error = writepack->commit(writepack, &append.stats);
+            writepack->free(writepack);
+        }
+        git_packbuilder_free(builder);
+        if (error)
+            throw odb_write_error();
+
+        git_mempack_reset(mempack_);
+        pending_.clear();
+        pending_bytes_ = 0;
+    }
 }
@@ -0,0 +1,166 @@
+#include "git2cpp/pmr_initializer.h"
+
+#include "reftable.h"
+
+#include <git2/common.h>
+#include <git2/global.h>
+#include <git2/sys/alloc.h>
+#include <git2/version.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace git
+{
+    namespace
+    {
+        std::pmr::memory_resource * resource = nullptr;
+
+        // every block starts with its size, which memory_resource::deallocate needs
+        struct alignas(std::max_align_t) Header
+        {
+            size_t size;
+        };
+
+        Header * header_of(void * ptr)
+        {
+            return reinterpret_cast<Header *>(ptr) - 1;
+        }
+
+        void * resource_malloc(size_t n, const char *, int)
+        {
+            if (n > SIZE_MAX - sizeof(Header))
+                return nullptr;
+            try
+            {
+                auto header = static_cast<Header *>(resource->allocate(sizeof(Header) + n, alignof(Header)));
+                header->size = n;
+                return header + 1;
+            }
+            catch (std::bad_alloc const &)
+            {
+                return nullptr;
+            }
+        }
+
+        void resource_free(void * ptr)
+        {
+            if (!ptr)
+                return;
+
+            Header * header = header_of(ptr);
+            resource->deallocate(header, sizeof(Header) + header->size, alignof(Header));
+        }
+
+        void * resource_realloc(void * ptr, size_t n, const char * file, int line)
+        {
+            if (!ptr)
+                return resource_malloc(n, file, line);
+
+            void * res = resource_malloc(n, file, line);
+            if (res)
+            {
+                std::memcpy(res, ptr, std::min(n, header_of(ptr)->size));
+                resource_free(ptr);
+            }
+            return res;
+        }
+
+#if LIBGIT2_VER_MAJOR == 1 && LIBGIT2_VER_MINOR < 6
+        // before 1.6 the allocator provides the derived functions itself
+
+        bool multiply(size_t & out, size_t a, size_t b)
+        {
+            if (b != 0 && a > SIZE_MAX / b)
+                return false;
+            out = a * b;
+            return true;
+        }
+
+        void * resource_calloc(size_t nelem, size_t elsize, const char * file, int line)
+        {
+            size_t n;
+            if (!multiply(n, nelem, elsize))
+                return nullptr;
+            void * res = resource_malloc(n, file, line);
+            if (res)
+                std::memset(res, 0, n);
+            return res;
+        }
+
+        char * resource_substrdup(const char * str, size_t n, const char * file, int line)
+        {
+            auto res = static_cast<char *>(resource_malloc(n + 1, file, line));
+            if (res)
+            {
+                std::memcpy(res, str, n);
+                res[n] = '\0';
+            }
+            return res;
+        }
+
+        char * resource_strdup(const char * str, const char * file, int line)
+        {
+            return resource_substrdup(str, std::strlen(str), file, line);
+        }
+
+        char * resource_strndup(const char * str, size_t n, const char * file, int line)
+        {
+            const void * end = std::memchr(str, '\0', n);
+            return resource_substrdup(str, end ? static_cast<const char *>(end) - str : n, file, line);
+        }
+
+        void * resource_reallocarray(void * ptr, size_t nelem, size_t elsize, const char * file, int line)
+        {
+            size_t n;
+            return multiply(n, nelem, elsize) ? resource_realloc(ptr, n, file, line) : nullptr;
+        }
+
+        void * resource_mallocarray(size_t nelem, size_t elsize, const char * file, int line)
+        {
+            return resource_reallocarray(nullptr, nelem, elsize, file, line);
+        }
+
+        git_allocator resource_allocator = {
+            resource_malloc,
+            resource_calloc,
+            resource_strdup,
+            resource_strndup,
+            resource_substrdup,
+            resource_realloc,
+            resource_reallocarray,
+            resource_mallocarray,
+            resource_free,
+        };
+#else
+        git_allocator resource_allocator = {
+            resource_malloc,
+            resource_realloc,
+            resource_free,
+        };
+#endif
+    }
+
+    PmrInitializer::PmrInitializer(std::pmr::memory_resource & res)
+    {
+        // git_libgit2_init keeps an allocator installed before it, so no block
+        // libgit2 allocates during initialization comes from malloc
+        resource = &res;
+        git_libgit2_opts(GIT_OPT_SET_ALLOCATOR, &resource_allocator);
+        git_libgit2_init();
+        internal::reftable::allow_ref_storage_extension();
+    }
+
+    PmrInitializer::~PmrInitializer()
+    {
+        if (git_libgit2_shutdown() == 0)
+        {
+            // shutdown keeps the installed allocator, so put the default one back
+            git_libgit2_opts(GIT_OPT_SET_ALLOCATOR, nullptr);
+            resource = nullptr;
+        }
+    }
+}
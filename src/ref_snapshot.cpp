@@ -0,0 +1,232 @@
+#include "git2cpp/ref_snapshot.h"
+#include "git2cpp/error.h"
+
+#include "file_mapping.h"
+#include "reftable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace git
+{
+    namespace
+    {
+        const size_t hex_size = GIT_OID_HEXSZ;
+
+        bool less_by_name(RefSnapshot::Ref const & a, RefSnapshot::Ref const & b)
+        {
+            return a.name < b.name;
+        }
+
+        bool parse_oid(git_oid & oid, char const * p, char const * end)
+        {
+            return size_t(end - p) >= hex_size && git_oid_fromstrn(&oid, p, hex_size) == 0;
+        }
+
+        /// Parses "<hex> <name>" lines with optional "^<hex>" peeled lines following them
+        void parse_packed_refs(char const * p, char const * end, std::vector<RefSnapshot::Ref> & refs, bool & sorted)
+        {
+            sorted = false;
+            while (p != end)
+            {
+                char const * eol = static_cast<char const *>(std::memchr(p, '\n', end - p));
+                if (!eol)
+                    eol = end;
+                char const * line_end = (eol != p && eol[-1] == '\r') ? eol - 1 : eol;
+
+                if (*p == '#')
+                {
+                    const std::string_view header(p, line_end - p);
+                    sorted = header.find(" sorted") != std::string_view::npos;
+                }
+                else if (*p == '^')
+                {
+                    if (refs.empty() || !parse_oid(refs.back().peeled, p + 1, line_end))
+                        throw refs_read_error("packed-refs");
+                    refs.back().has_peeled = true;
+                }
+                else if (p != line_end)
+                {
+                    RefSnapshot::Ref ref = {};
+                    if (!parse_oid(ref.id, p, line_end) || p + hex_size == line_end || p[hex_size] != ' ')
+                        throw refs_read_error("packed-refs");
+                    ref.name = std::string_view(p + hex_size + 1, line_end - (p + hex_size + 1));
+                    refs.push_back(ref);
+                }
+
+                p = eol == end ? end : eol + 1;
+            }
+        }
+
+        struct LooseRef
+        {
+            size_t name_offset, name_size;
+            size_t target_offset, target_size;
+            git_oid id;
+        };
+
+        void read_loose_refs(std::filesystem::path const & commondir, std::string & names, std::vector<LooseRef> & refs)
+        {
+            std::error_code ec;
+            std::filesystem::recursive_directory_iterator it(commondir / "refs", ec), end;
+            for (; !ec && it != end; it.increment(ec))
+            {
+                if (!it->is_regular_file(ec))
+                    continue;
+
+                auto const & file = it->path();
+                if (file.extension() == ".lock")
+                    continue;
+
+                std::ifstream in(file, std::ios::binary);
+                std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                while (!content.empty() && (content.back() == '\n' || content.back() == '\r' || content.back() == ' '))
+                    content.pop_back();
+
+                LooseRef ref = {};
+                ref.name_offset = names.size();
+                names += file.lexically_relative(commondir).generic_string();
+                ref.name_size = names.size() - ref.name_offset;
+
+                if (content.compare(0, 5, "ref: ") == 0)
+                {
+                    ref.target_offset = names.size();
+                    names.append(content, 5, std::string::npos);
+                    ref.target_size = names.size() - ref.target_offset;
+                }
+                else if (!parse_oid(ref.id, content.data(), content.data() + content.size()))
+                {
+                    // being written, or not a ref at all
+                    names.resize(ref.name_offset);
+                    continue;
+                }
+                refs.push_back(ref);
+            }
+        }
+    }
+
+    void RefSnapshot::Destroy::operator()(internal::FileMapping * file) const
+    {
+        delete file;
+    }
+
+    RefSnapshot::RefSnapshot(const char * commondir)
+        : loose_count_(0)
+    {
+        const std::filesystem::path dir(commondir);
+        if (internal::reftable::Stack::exists(commondir))
+        {
+            read_reftable(dir.string() + "/reftable");
+            return;
+        }
+
+        std::vector<Ref> packed;
+        const auto packed_path = dir / "packed-refs";
+        std::error_code ec;
+        if (std::filesystem::exists(packed_path, ec))
+        {
+            packed_.reset(new internal::FileMapping(packed_path.string().c_str()));
+            if (!*packed_)
+                throw refs_read_error("packed-refs");
+
+            auto data = reinterpret_cast<char const *>(packed_->data());
+            bool sorted;
+            parse_packed_refs(data, data + packed_->size(), packed, sorted);
+            if (!sorted)
+                std::sort(packed.begin(), packed.end(), less_by_name);
+        }
+
+        std::string loose_names;
+        std::vector<LooseRef> loose_refs;
+        read_loose_refs(dir, loose_names, loose_refs);
+        set_names(loose_names);
+
+        std::vector<Ref> loose;
+        loose.reserve(loose_refs.size());
+        for (auto const & l : loose_refs)
+        {
+            Ref ref = {};
+            ref.name = std::string_view(names_.get() + l.name_offset, l.name_size);
+            ref.id = l.id;
+            if (l.target_size)
+                ref.symbolic_target = std::string_view(names_.get() + l.target_offset, l.target_size);
+            loose.push_back(ref);
+        }
+        std::sort(loose.begin(), loose.end(), less_by_name);
+        loose_count_ = loose.size();
+
+        // loose refs take precedence over packed ones
+        refs_.reserve(packed.size() + loose.size());
+        auto p = packed.begin();
+        for (auto const & ref : loose)
+        {
+            for (; p != packed.end() && p->name < ref.name; ++p)
+                refs_.push_back(*p);
+            if (p != packed.end() && p->name == ref.name)
+                ++p;
+            refs_.push_back(ref);
+        }
+        refs_.insert(refs_.end(), p, packed.end());
+    }
+
+    void RefSnapshot::read_reftable(std::string const & dir)
+    {
+        internal::reftable::Stack stack(dir);
+        std::vector<internal::reftable::Record> records;
+        if (stack.reload() || stack.read_prefix("refs/", records))
+            throw refs_read_error("reftable");
+
+        size_t size = 0;
+        for (auto const & record : records)
+            size += record.name.size() + record.target.size();
+        names_.reset(new char[size]);
+        size_t offset = 0;
+        auto append = [this, &offset](std::string const & str) {
+            std::memcpy(names_.get() + offset, str.data(), str.size());
+            offset += str.size();
+            return std::string_view(names_.get() + offset - str.size(), str.size());
+        };
+
+        refs_.reserve(records.size());
+        for (auto const & record : records)
+        {
+            Ref ref = {};
+            ref.name = append(record.name);
+            if (record.type == internal::reftable::symref)
+                ref.symbolic_target = append(record.target);
+            else
+                ref.id = record.id;
+            if (record.type == internal::reftable::two_ids)
+            {
+                ref.peeled = record.peeled;
+                ref.has_peeled = true;
+            }
+            refs_.push_back(ref);
+        }
+    }
+
+    void RefSnapshot::set_names(std::string const & str)
+    {
+        names_.reset(new char[str.size()]);
+        std::memcpy(names_.get(), str.data(), str.size());
+    }
+
+    RefSnapshot::Ref const * RefSnapshot::find(std::string_view name) const
+    {
+        auto it = std::lower_bound(refs_.begin(), refs_.end(), name,
+                                   [] (Ref const & ref, std::string_view name) { return ref.name < name; });
+        return (it != refs_.end() && it->name == name) ? &*it : nullptr;
+    }
+
+    std::pair<size_t, size_t> RefSnapshot::prefix_range(std::string_view prefix) const
+    {
+        auto first = std::lower_bound(refs_.begin(), refs_.end(), prefix,
+                                      [] (Ref const & ref, std::string_view prefix) { return ref.name < prefix; });
+        auto last = std::upper_bound(first, refs_.end(), prefix,
+                                     [] (std::string_view prefix, Ref const & ref) { return ref.name.substr(0, prefix.size()) > prefix; });
+        return { size_t(first - refs_.begin()), size_t(last - refs_.begin()) };
+    }
+}
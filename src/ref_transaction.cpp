@@ -0,0 +1,394 @@
+#include "git2cpp/ref_transaction.h"
+#include "git2cpp/error.h"
+
+#include "reftable.h"
+
+#include <git2/config.h>
+#include <git2/errors.h>
+#include <git2/object.h>
+#include <git2/refs.h>
+#include <git2/repository.h>
+#include <git2/tag.h>
+#include <git2/transaction.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace git
+{
+    namespace
+    {
+        struct TransactionDestroy
+        {
+            void operator() (git_transaction * tr) const { git_transaction_free(tr); }
+        };
+
+        bool starts_with(std::string const & str, const char * prefix)
+        {
+            return str.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+        }
+
+        /// Where the files backend keeps the loose ref; per-worktree refs live in the worktree's own directory
+        fs::path loose_path(git_repository * repo, std::string const & name)
+        {
+            const bool shared = starts_with(name, "refs/") && !starts_with(name, "refs/bisect/")
+                             && !starts_with(name, "refs/worktree/") && !starts_with(name, "refs/rewritten/");
+            return fs::u8path(shared ? git_repository_commondir(repo) : git_repository_path(repo)) / fs::u8path(name);
+        }
+
+        /// Updates are only written to `packed-refs` for refs that libgit2 would not log:
+        /// logging stays with libgit2, which writes loose refs
+        bool logs_updates(git_repository * repo, std::string const & name)
+        {
+            if (git_reference_has_log(repo, name.c_str()) != 0 || starts_with(name, "refs/heads/")
+                || starts_with(name, "refs/remotes/") || starts_with(name, "refs/notes/"))
+            {
+                return true;
+            }
+
+            git_config * config;
+            if (git_repository_config_snapshot(&config, repo))
+                return true;
+            const char * value = nullptr;
+            const bool always = git_config_get_string(&value, config, "core.logAllRefUpdates") == 0 && std::string(value) == "always";
+            git_config_free(config);
+            return always;
+        }
+
+        /// `packed-refs` held under its lock file, rewritten at once by commit()
+        struct PackedRefs
+        {
+            explicit PackedRefs(const char * commondir)
+                : path_(fs::u8path(commondir) / "packed-refs")
+                , lock_path_(fs::u8path(commondir) / "packed-refs.lock")
+            {}
+
+            PackedRefs(PackedRefs const &) = delete;
+            PackedRefs & operator=(PackedRefs const &) = delete;
+
+            ~PackedRefs()
+            {
+                if (locked_)
+                {
+                    std::error_code ec;
+                    fs::remove(lock_path_, ec);
+                }
+            }
+
+            /// @return false if somebody else holds the lock
+            bool lock()
+            {
+                // "x" fails if the lock file exists
+                FILE * file = std::fopen(lock_path_.string().c_str(), "wbx");
+                if (!file)
+                    return false;
+                std::fclose(file);
+                locked_ = true;
+                return true;
+            }
+
+            void read()
+            {
+                std::ifstream in(path_, std::ios::binary);
+                std::string line;
+                std::string * last = nullptr;
+                while (std::getline(in, line))
+                {
+                    if (line.empty())
+                        continue;
+                    if (line[0] == '#')
+                        header_ += line + '\n';
+                    else if (line[0] == '^' && last)
+                        *last += line + '\n';
+                    else if (auto space = line.find(' '); space != std::string::npos)
+                        last = &(entries_[line.substr(space + 1)] = line + '\n');
+                }
+            }
+
+            bool contains(std::string const & name) const { return entries_.count(name) != 0; }
+
+            void remove(std::string const & name)
+            {
+                changed_ |= entries_.erase(name) != 0;
+            }
+
+            void set(git_repository * repo, std::string const & name, git_oid const & target)
+            {
+                std::string & entry = entries_[name];
+                entry = std::string(git_oid_tostr_s(&target)) + ' ' + name + '\n';
+
+                // annotated tags keep their peeled line, which "fully-peeled" files need
+                git_object * obj;
+                if (git_object_lookup(&obj, repo, &target, GIT_OBJECT_TAG) == 0)
+                {
+                    git_object * peeled;
+                    if (git_tag_peel(&peeled, reinterpret_cast<git_tag *>(obj)) == 0)
+                    {
+                        entry += std::string("^") + git_oid_tostr_s(git_object_id(peeled)) + '\n';
+                        git_object_free(peeled);
+                    }
+                    git_object_free(obj);
+                }
+                git_error_clear();
+                changed_ = true;
+            }
+
+            bool changed() const { return changed_; }
+
+            /// Writes the lock file and renames it over `packed-refs`
+            /// @return false if the file could not be written; `packed-refs` is unchanged then
+            bool commit()
+            {
+                {
+                    std::ofstream out(lock_path_, std::ios::binary | std::ios::trunc);
+                    out << header_;
+                    for (auto const & entry : entries_)
+                        out << entry.second;
+                    out.close();
+                    if (!out)
+                        return false;
+                }
+                std::error_code ec;
+                fs::rename(lock_path_, path_, ec);
+                if (ec)
+                    return false;
+                locked_ = false;
+                return true;
+            }
+
+        private:
+            const fs::path path_;
+            const fs::path lock_path_;
+            bool locked_ = false;
+            bool changed_ = false;
+            std::string header_;
+            std::map<std::string, std::string> entries_;    ///< lines of each ref, by name
+        };
+    }
+
+    void RefTransaction::create(std::string name, git_oid const & target, std::string log_message)
+    {
+        ops_.push_back(Op{ Kind::create, std::move(name), target, {}, std::move(log_message) });
+    }
+
+    void RefTransaction::update(std::string name, git_oid const & target, git_oid const & expected_old, std::string log_message)
+    {
+        ops_.push_back(Op{ Kind::update, std::move(name), target, expected_old, std::move(log_message) });
+    }
+
+    void RefTransaction::remove(std::string name, git_oid const & expected_old)
+    {
+        ops_.push_back(Op{ Kind::remove, std::move(name), {}, expected_old, {} });
+    }
+
+    std::vector<RefTransaction::Conflict> RefTransaction::commit()
+    {
+        const char * commondir = git_repository_commondir(repo_);
+        if (commondir && internal::reftable::Stack::exists(commondir))
+            return commit_reftable(commondir);
+
+        git_transaction * raw;
+        if (git_transaction_new(&raw, repo_))
+            throw ref_transaction_error();
+        std::unique_ptr<git_transaction, TransactionDestroy> tr(raw);
+
+        // lock everything first, so the values checked below can't change before the commit
+        std::vector<Conflict> conflicts;
+        for (auto const & op : ops_)
+        {
+            if (git_transaction_lock_ref(tr.get(), op.name.c_str()))
+            {
+                conflicts.push_back({ op.name, Conflict::Reason::locked });
+                continue;
+            }
+
+            git_reference * ref;
+            const bool exists = git_reference_lookup(&ref, repo_, op.name.c_str()) == 0;
+            if (!exists)
+            {
+                if (op.kind != Kind::create)
+                    conflicts.push_back({ op.name, Conflict::Reason::unexpected_value });
+                continue;
+            }
+
+            const bool expected = op.kind != Kind::create
+                               && git_reference_type(ref) == GIT_REFERENCE_DIRECT
+                               && git_oid_equal(git_reference_target(ref), &op.expected_old);
+            git_reference_free(ref);
+            if (op.kind == Kind::create)
+                conflicts.push_back({ op.name, Conflict::Reason::already_exists });
+            else if (!expected)
+                conflicts.push_back({ op.name, Conflict::Reason::unexpected_value });
+        }
+        if (!conflicts.empty())
+            return conflicts;
+
+        // deletions, and updates of refs that only exist there, go into one rewrite of `packed-refs`
+        std::vector<bool> loose(ops_.size());
+        for (size_t i = 0; i != ops_.size(); ++i)
+        {
+            std::error_code ec;
+            loose[i] = !commondir || fs::exists(loose_path(repo_, ops_[i].name), ec);
+        }
+
+        std::unique_ptr<PackedRefs> packed;
+        std::vector<bool> in_packed(ops_.size());
+        for (size_t i = 0; i != ops_.size(); ++i)
+        {
+            auto const & op = ops_[i];
+            if (!commondir || (loose[i] && op.kind != Kind::remove))
+                continue;
+            if (!packed)
+            {
+                packed.reset(new PackedRefs(commondir));
+                if (!packed->lock())
+                {
+                    for (auto const & other : ops_)
+                        conflicts.push_back({ other.name, Conflict::Reason::locked });
+                    return conflicts;
+                }
+                packed->read();
+            }
+
+            if (op.kind == Kind::remove)
+                packed->remove(op.name);
+            else if (op.kind == Kind::update && packed->contains(op.name) && !logs_updates(repo_, op.name))
+            {
+                packed->set(repo_, op.name, op.target);
+                in_packed[i] = true;
+            }
+        }
+
+        for (size_t i = 0; i != ops_.size(); ++i)
+        {
+            auto const & op = ops_[i];
+            const char * message = op.log_message.empty() ? nullptr : op.log_message.c_str();
+            int error = 0;
+            if (op.kind == Kind::remove)
+                error = loose[i] ? git_transaction_remove(tr.get(), op.name.c_str()) : 0;
+            else if (!in_packed[i])
+                error = git_transaction_set_target(tr.get(), op.name.c_str(), &op.target, nullptr, message);
+            if (error)
+                throw ref_transaction_error();
+        }
+
+        if (packed && packed->changed() && !packed->commit())
+        {
+            git_error_set_str(GIT_ERROR_REFERENCE, "could not write packed-refs");
+            throw ref_transaction_error();
+        }
+        packed.reset();
+
+        if (git_transaction_commit(tr.get()))
+        {
+            // libgit2 writes the loose refs one at a time: put back those written before the failure
+            const git_error * last = git_error_last();
+            const std::string message = last && last->message ? last->message : "could not write references";
+            tr.reset();
+            roll_back();
+            git_error_set_str(GIT_ERROR_REFERENCE, message.c_str());
+            throw ref_transaction_error();
+        }
+
+        ops_.clear();
+        return conflicts;
+    }
+
+    void RefTransaction::roll_back()
+    {
+        for (auto const & op : ops_)
+        {
+            git_reference * ref = nullptr;
+            const bool exists = git_reference_lookup(&ref, repo_, op.name.c_str()) == 0;
+            const bool applied = op.kind == Kind::remove
+                                     ? !exists
+                                     : exists && git_reference_type(ref) == GIT_REFERENCE_DIRECT
+                                           && git_oid_equal(git_reference_target(ref), &op.target);
+            if (applied)
+            {
+                git_reference * restored = nullptr;
+                if (op.kind == Kind::create)
+                    git_reference_delete(ref);
+                else if (op.kind == Kind::update)
+                    git_reference_create_matching(&restored, repo_, op.name.c_str(), &op.expected_old, 1, &op.target, nullptr);
+                else
+                    git_reference_create(&restored, repo_, op.name.c_str(), &op.expected_old, 0, nullptr);
+                git_reference_free(restored);
+            }
+            git_reference_free(ref);
+        }
+    }
+
+    std::vector<RefTransaction::Conflict> RefTransaction::commit_reftable(const char * commondir)
+    {
+        using namespace internal::reftable;
+
+        std::vector<Record> records;
+        for (auto const & op : ops_)
+        {
+            Record record;
+            record.name = op.name;
+            if (op.kind != Kind::remove)
+            {
+                record.type = one_id;
+                record.id = op.target;
+            }
+            records.push_back(std::move(record));
+        }
+
+        // the whole transaction is one table, added under the lock of the stack
+        std::vector<Conflict> conflicts;
+        Stack stack((fs::u8path(commondir) / "reftable").string());
+        const int error = stack.add(std::move(records), [&](Stack const & current, std::vector<Record> &) {
+            std::vector<std::string> seen;
+            for (auto const & op : ops_)
+            {
+                // a name can't be written twice into one table
+                if (std::find(seen.begin(), seen.end(), op.name) != seen.end())
+                {
+                    conflicts.push_back({ op.name, Conflict::Reason::locked });
+                    continue;
+                }
+                seen.push_back(op.name);
+
+                Record record;
+                const int error = current.find(op.name, record);
+                if (error && error != GIT_ENOTFOUND)
+                    return error;
+                if (op.kind == Kind::create)
+                {
+                    const int collision = error ? current.name_conflict(op.name) : GIT_EEXISTS;
+                    if (collision == GIT_EEXISTS)
+                        conflicts.push_back({ op.name, Conflict::Reason::already_exists });
+                    else if (collision)
+                        return collision;
+                }
+                else if (error || record.type == symref || !git_oid_equal(&record.id, &op.expected_old))
+                {
+                    conflicts.push_back({ op.name, Conflict::Reason::unexpected_value });
+                }
+            }
+            return conflicts.empty() ? 0 : GIT_EMODIFIED;
+        });
+
+        if (error == GIT_ELOCKED)
+        {
+            for (auto const & op : ops_)
+                conflicts.push_back({ op.name, Conflict::Reason::locked });
+        }
+        if (!conflicts.empty())
+            return conflicts;
+        if (error)
+            throw ref_transaction_error();
+
+        ops_.clear();
+        return conflicts;
+    }
+}
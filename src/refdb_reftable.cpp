@@ -0,0 +1,446 @@
+#include "reftable.h"
+
+#include <git2/common.h>
+#include <git2/errors.h>
+#include <git2/refs.h>
+#include <git2/strarray.h>
+#include <git2/sys/refdb_backend.h>
+#include <git2/sys/refs.h>
+#include <git2/version.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace git {
+namespace internal {
+namespace reftable
+{
+    namespace
+    {
+        int set_error(std::string const & message, int error = GIT_ERROR)
+        {
+            git_error_set_str(GIT_ERROR_REFERENCE, message.c_str());
+            return error;
+        }
+
+        /// Exceptions must not cross libgit2's callbacks
+        template <typename F>
+        int guarded(F && f) noexcept
+        {
+            try
+            {
+                return f();
+            }
+            catch (std::bad_alloc const &)
+            {
+                git_error_set_oom();
+                return GIT_ERROR;
+            }
+            catch (std::exception const & e)
+            {
+                return set_error(e.what());
+            }
+        }
+
+        /// fnmatch without flags, as the files backend matches globs: `*` also matches `/`
+        bool glob_match(const char * pattern, const char * str)
+        {
+            for (; *pattern; ++pattern, ++str)
+            {
+                if (*pattern == '*')
+                {
+                    while (*pattern == '*')
+                        ++pattern;
+                    for (;; ++str)
+                    {
+                        if (glob_match(pattern, str))
+                            return true;
+                        if (!*str)
+                            return false;
+                    }
+                }
+                if (!*str)
+                    return false;
+                if (*pattern == '?')
+                    continue;
+                if (*pattern == '[')
+                {
+                    const char * p = pattern + 1;
+                    const bool negate = *p == '!' || *p == '^';
+                    if (negate)
+                        ++p;
+                    const char * first = p;
+                    bool matched = false;
+                    for (; *p && (*p != ']' || p == first); ++p)
+                    {
+                        if (p[1] == '-' && p[2] && p[2] != ']')
+                        {
+                            matched |= *p <= *str && *str <= p[2];
+                            p += 2;
+                        }
+                        else
+                            matched |= *p == *str;
+                    }
+                    if (*p == ']')
+                    {
+                        if (matched == negate)
+                            return false;
+                        pattern = p;
+                        continue;
+                    }
+                    // no closing bracket: a literal '['
+                }
+                if (*pattern == '\\' && pattern[1])
+                    ++pattern;
+                if (*pattern != *str)
+                    return false;
+            }
+            return !*str;
+        }
+
+        git_reference * to_reference(Record const & record)
+        {
+            git_reference * ref = record.type == symref
+                                      ? git_reference__alloc_symbolic(record.name.c_str(), record.target.c_str())
+                                      : git_reference__alloc(record.name.c_str(), &record.id, record.type == two_ids ? &record.peeled : nullptr);
+            if (!ref)
+                throw std::bad_alloc();
+            return ref;
+        }
+
+        Record to_record(git_reference const * ref)
+        {
+            Record record;
+            record.name = git_reference_name(ref);
+            if (git_reference_type(ref) == GIT_REFERENCE_SYMBOLIC)
+            {
+                record.type = symref;
+                record.target = git_reference_symbolic_target(ref);
+                return record;
+            }
+            record.type = one_id;
+            record.id = *git_reference_target(ref);
+            if (git_oid const * peeled = git_reference_target_peel(ref))
+            {
+                record.type = two_ids;
+                record.peeled = *peeled;
+            }
+            return record;
+        }
+
+        int not_found(std::string const & name)
+        {
+            return set_error("reference '" + name + "' not found", GIT_ENOTFOUND);
+        }
+
+        int check_old_value(Record const * current, git_oid const * old_id, const char * old_target)
+        {
+            if (old_id && (!current || current->type == symref || !git_oid_equal(&current->id, old_id)))
+                return set_error("old reference value does not match", GIT_EMODIFIED);
+            if (old_target && (!current || current->type != symref || current->target != old_target))
+                return set_error("old reference symbolic target does not match", GIT_EMODIFIED);
+            return 0;
+        }
+
+        int check_write(Stack const & stack, std::string const & name, bool force,
+                        git_oid const * old_id, const char * old_target, std::string const & ignored)
+        {
+            Record current;
+            int error = stack.find(name, current);
+            if (error && error != GIT_ENOTFOUND)
+                return error;
+            const bool exists = !error;
+            if (exists && !force)
+                return set_error("failed to write reference '" + name + "': a reference with that name already exists.", GIT_EEXISTS);
+            if ((error = check_old_value(exists ? &current : nullptr, old_id, old_target)))
+                return error;
+            return exists ? 0 : stack.name_conflict(name, ignored);
+        }
+
+        struct Backend : git_refdb_backend
+        {
+            explicit Backend(const char * commondir)
+                : stack((std::filesystem::path(commondir) / "reftable").string())
+            {}
+
+            Stack stack;
+            std::mutex mutex;
+        };
+
+        Backend & self(git_refdb_backend * backend)
+        {
+            return *static_cast<Backend *>(backend);
+        }
+
+        struct Iterator : git_reference_iterator
+        {
+            std::vector<Record> records;
+            size_t next_record = 0;
+        };
+
+        int iterator_next(git_reference ** out, git_reference_iterator * it)
+        {
+            auto & iter = static_cast<Iterator &>(*it);
+            if (iter.next_record == iter.records.size())
+                return GIT_ITEROVER;
+            return guarded([&] {
+                *out = to_reference(iter.records[iter.next_record++]);
+                return 0;
+            });
+        }
+
+        int iterator_next_name(const char ** out, git_reference_iterator * it)
+        {
+            auto & iter = static_cast<Iterator &>(*it);
+            if (iter.next_record == iter.records.size())
+                return GIT_ITEROVER;
+            *out = iter.records[iter.next_record++].name.c_str();
+            return 0;
+        }
+
+        void iterator_free(git_reference_iterator * it)
+        {
+            delete static_cast<Iterator *>(it);
+        }
+
+        int backend_exists(int * exists, git_refdb_backend * backend, const char * name)
+        {
+            return guarded([&] {
+                auto & b = self(backend);
+                std::lock_guard<std::mutex> lock(b.mutex);
+                Record record;
+                int error = b.stack.reload();
+                if (!error)
+                    error = b.stack.find(name, record);
+                *exists = !error;
+                return error == GIT_ENOTFOUND ? 0 : error;
+            });
+        }
+
+        int backend_lookup(git_reference ** out, git_refdb_backend * backend, const char * name)
+        {
+            return guarded([&] {
+                auto & b = self(backend);
+                std::lock_guard<std::mutex> lock(b.mutex);
+                Record record;
+                int error = b.stack.reload();
+                if (!error)
+                    error = b.stack.find(name, record);
+                if (error)
+                    return error == GIT_ENOTFOUND ? not_found(name) : error;
+                *out = to_reference(record);
+                return 0;
+            });
+        }
+
+        int backend_iterator(git_reference_iterator ** out, git_refdb_backend * backend, const char * glob)
+        {
+            return guarded([&] {
+                auto & b = self(backend);
+                std::lock_guard<std::mutex> lock(b.mutex);
+                if (int error = b.stack.reload())
+                    return error;
+
+                // only the literal start of the glob narrows the range that is read
+                std::string_view prefix = "refs/";
+                if (glob)
+                {
+                    const std::string_view literal(glob, std::strcspn(glob, "*?[\\"));
+                    if (literal.compare(0, prefix.size(), prefix) == 0)
+                        prefix = literal;
+                }
+
+                auto iter = std::make_unique<Iterator>();
+                if (int error = b.stack.read_prefix(prefix, iter->records))
+                    return error;
+                if (glob)
+                {
+                    auto & records = iter->records;
+                    records.erase(std::remove_if(records.begin(), records.end(),
+                                                 [&](Record const & r) { return !glob_match(glob, r.name.c_str()); }),
+                                  records.end());
+                }
+                iter->next = iterator_next;
+                iter->next_name = iterator_next_name;
+                iter->free = iterator_free;
+                *out = iter.release();
+                return 0;
+            });
+        }
+
+        int backend_write(git_refdb_backend * backend, git_reference const * ref, int force, git_signature const *,
+                          const char *, git_oid const * old_id, const char * old_target)
+        {
+            return guarded([&] {
+                auto & b = self(backend);
+                std::lock_guard<std::mutex> lock(b.mutex);
+                Record record = to_record(ref);
+                return b.stack.add({ record }, [&](Stack const & stack, std::vector<Record> &) {
+                    return check_write(stack, record.name, force != 0, old_id, old_target, {});
+                });
+            });
+        }
+
+        int backend_rename(git_reference ** out, git_refdb_backend * backend, const char * old_name, const char * new_name,
+                           int force, git_signature const *, const char *)
+        {
+            *out = nullptr;
+            return guarded([&] {
+                auto & b = self(backend);
+                std::lock_guard<std::mutex> lock(b.mutex);
+                Record renamed;
+                const int error = b.stack.add({}, [&](Stack const & stack, std::vector<Record> & records) {
+                    int error = stack.find(old_name, renamed);
+                    if (error)
+                        return error == GIT_ENOTFOUND ? not_found(old_name) : error;
+                    if ((error = check_write(stack, new_name, force != 0, nullptr, nullptr, old_name)))
+                        return error;
+
+                    Record removed;
+                    removed.name = old_name;
+                    renamed.name = new_name;
+                    if (removed.name != renamed.name)
+                        records.push_back(removed);
+                    records.push_back(renamed);
+                    return 0;
+                });
+                if (error)
+                    return error;
+                *out = to_reference(renamed);
+                return 0;
+            });
+        }
+
+        int backend_del(git_refdb_backend * backend, const char * name, git_oid const * old_id, const char * old_target)
+        {
+            return guarded([&] {
+                auto & b = self(backend);
+                std::lock_guard<std::mutex> lock(b.mutex);
+                return b.stack.add({}, [&](Stack const & stack, std::vector<Record> & records) {
+                    Record current;
+                    int error = stack.find(name, current);
+                    if (error)
+                        return error == GIT_ENOTFOUND ? not_found(name) : error;
+                    if ((error = check_old_value(&current, old_id, old_target)))
+                        return error;
+
+                    Record removed;
+                    removed.name = name;
+                    records.push_back(removed);
+                    return 0;
+                });
+            });
+        }
+
+        int backend_compress(git_refdb_backend * backend)
+        {
+            return guarded([&] {
+                auto & b = self(backend);
+                std::lock_guard<std::mutex> lock(b.mutex);
+                return b.stack.compact();
+            });
+        }
+
+        int backend_has_log(git_refdb_backend *, const char *)
+        {
+            return 0;
+        }
+
+        int backend_ensure_log(git_refdb_backend *, const char *)
+        {
+            return 0;
+        }
+
+        int backend_reflog_read(git_reflog **, git_refdb_backend *, const char * name)
+        {
+            return set_error(std::string("cannot read the reflog of '") + name + "': reftable reflogs are not supported");
+        }
+
+        int backend_reflog_write(git_refdb_backend *, git_reflog *)
+        {
+            return set_error("reftable reflogs are not supported");
+        }
+
+        int backend_reflog_rename(git_refdb_backend *, const char *, const char *)
+        {
+            return 0;
+        }
+
+        int backend_reflog_delete(git_refdb_backend *, const char *)
+        {
+            return 0;
+        }
+
+        /// Transactions lock their refs one by one; every write takes the lock of the whole stack
+        /// instead, and checks the expected values under it
+        int backend_lock(void ** payload, git_refdb_backend *, const char * name)
+        {
+            return guarded([&] {
+                *payload = new std::string(name);
+                return 0;
+            });
+        }
+
+        int backend_unlock(git_refdb_backend * backend, void * payload, int success, int, git_reference const * ref,
+                           git_signature const * sig, const char * message)
+        {
+            std::unique_ptr<std::string> name(static_cast<std::string *>(payload));
+            if (success == 2)
+                return backend_del(backend, name->c_str(), nullptr, nullptr);
+            if (success)
+                return backend_write(backend, ref, true, sig, message, nullptr, nullptr);
+            return 0;
+        }
+
+        void backend_free(git_refdb_backend * backend)
+        {
+            delete static_cast<Backend *>(backend);
+        }
+    }
+
+    git_refdb_backend * new_refdb_backend(const char * commondir)
+    {
+        auto backend = std::make_unique<Backend>(commondir);
+        git_refdb_init_backend(backend.get(), GIT_REFDB_BACKEND_VERSION);
+        backend->exists = backend_exists;
+        backend->lookup = backend_lookup;
+        backend->iterator = backend_iterator;
+        backend->write = backend_write;
+        backend->rename = backend_rename;
+        backend->del = backend_del;
+        backend->compress = backend_compress;
+        backend->has_log = backend_has_log;
+        backend->ensure_log = backend_ensure_log;
+        backend->free = backend_free;
+        backend->reflog_read = backend_reflog_read;
+        backend->reflog_write = backend_reflog_write;
+        backend->reflog_rename = backend_reflog_rename;
+        backend->reflog_delete = backend_reflog_delete;
+        backend->lock = backend_lock;
+        backend->unlock = backend_unlock;
+        return backend.release();
+    }
+
+    void allow_ref_storage_extension()
+    {
+#if LIBGIT2_VER_MAJOR > 1 || LIBGIT2_VER_MINOR >= 4
+        git_strarray current = {};
+        if (git_libgit2_opts(GIT_OPT_GET_EXTENSIONS, &current))
+            return;
+        std::vector<const char *> names(current.strings, current.strings + current.count);
+        auto is_ref_storage = [](const char * name) { return std::strcmp(name, "refstorage") == 0; };
+        if (std::none_of(names.begin(), names.end(), is_ref_storage))
+        {
+            names.push_back("refstorage");
+            git_libgit2_opts(GIT_OPT_SET_EXTENSIONS, names.data(), names.size());
+        }
+        git_strarray_dispose(&current);
+#endif
+    }
+}}}
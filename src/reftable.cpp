@@ -0,0 +1,822 @@
+#include "reftable.h"
+
+#include <git2/errors.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace git {
+namespace internal {
+namespace reftable
+{
+    namespace
+    {
+        namespace fs = std::filesystem;
+
+        const size_t header_size_v1 = 24;
+        const size_t header_size_v2 = 28;   ///< followed by the hash id
+        const size_t footer_fields_size = 5 * 8 + 4;
+        const size_t block_header_size = 4;
+        const size_t restart_interval = 16;
+        const size_t max_unindexed_blocks = 3;
+        const uint32_t sha1_hash_id = 0x73686131;  // "sha1"
+
+        int set_error(int error_class, std::string const & message, int error = GIT_ERROR)
+        {
+            git_error_set_str(error_class, message.c_str());
+            return error;
+        }
+
+        uint64_t get_be(unsigned char const * p, size_t size)
+        {
+            uint64_t res = 0;
+            for (size_t i = 0; i != size; ++i)
+                res = (res << 8) | p[i];
+            return res;
+        }
+
+        void put_be(std::vector<unsigned char> & out, uint64_t value, size_t size)
+        {
+            for (size_t i = size; i-- != 0;)
+                out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+        }
+
+        /// git's offset varint: every continuation adds one, so that each value has a single encoding
+        bool get_varint(unsigned char const *& p, unsigned char const * end, uint64_t & value)
+        {
+            if (p == end)
+                return false;
+            unsigned char c = *p++;
+            value = c & 0x7f;
+            while (c & 0x80)
+            {
+                if (p == end || value > (UINT64_MAX >> 7) - 1)
+                    return false;
+                c = *p++;
+                value = ((value + 1) << 7) | (c & 0x7f);
+            }
+            return true;
+        }
+
+        void put_varint(std::vector<unsigned char> & out, uint64_t value)
+        {
+            unsigned char buf[10];
+            size_t pos = sizeof(buf) - 1;
+            buf[pos] = value & 0x7f;
+            while (value >>= 7)
+                buf[--pos] = 0x80 | (--value & 0x7f);
+            out.insert(out.end(), buf + pos, buf + sizeof(buf));
+        }
+
+        bool get_id(unsigned char const *& p, unsigned char const * end, git_oid & id)
+        {
+            if (size_t(end - p) < GIT_OID_RAWSZ)
+                return false;
+            std::memcpy(id.id, p, GIT_OID_RAWSZ);
+            p += GIT_OID_RAWSZ;
+            return true;
+        }
+
+        void put_id(std::vector<unsigned char> & out, git_oid const & id)
+        {
+            out.insert(out.end(), id.id, id.id + GIT_OID_RAWSZ);
+        }
+
+        uint32_t crc32(unsigned char const * p, size_t size)
+        {
+            uint32_t crc = 0xffffffff;
+            for (size_t i = 0; i != size; ++i)
+            {
+                crc ^= p[i];
+                for (int bit = 0; bit != 8; ++bit)
+                    crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+            }
+            return ~crc;
+        }
+
+        bool starts_with(std::string const & str, std::string_view prefix)
+        {
+            return str.compare(0, prefix.size(), prefix) == 0;
+        }
+
+        bool read_file(std::string const & path, std::string & content)
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return false;
+            content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            return !in.bad();
+        }
+
+        /// Writes the records of one block; restart points hold whole keys
+        struct BlockWriter
+        {
+            BlockWriter(std::vector<unsigned char> & out, char type, size_t header_offset)
+                : out_(out)
+                , start_(out.size() - header_offset)
+                , header_offset_(header_offset)
+            {
+                out.push_back(static_cast<unsigned char>(type));
+                out.insert(out.end(), 3, 0);
+            }
+
+            /// @return false if the record does not fit, which leaves the block unchanged
+            bool add(std::string const & key, uint8_t extra, std::vector<unsigned char> const & value, uint32_t block_size)
+            {
+                const bool restart = entries_ % restart_interval == 0;
+                size_t prefix = 0;
+                if (!restart)
+                {
+                    while (prefix != key.size() && prefix != last_key_.size() && key[prefix] == last_key_[prefix])
+                        ++prefix;
+                }
+
+                record_.clear();
+                put_varint(record_, prefix);
+                put_varint(record_, (uint64_t(key.size() - prefix) << 3) | extra);
+                record_.insert(record_.end(), key.begin() + prefix, key.end());
+                record_.insert(record_.end(), value.begin(), value.end());
+
+                const size_t restarts = restarts_.size() + restart;
+                if (out_.size() - start_ + record_.size() + 3 * restarts + 2 > block_size)
+                    return false;
+
+                if (restart)
+                    restarts_.push_back(out_.size() - start_);
+                out_.insert(out_.end(), record_.begin(), record_.end());
+                last_key_ = key;
+                ++entries_;
+                return true;
+            }
+
+            /// Appends the restart points and pads the block to block_size
+            void finish(uint32_t block_size)
+            {
+                for (size_t restart : restarts_)
+                    put_be(out_, restart, 3);
+                put_be(out_, restarts_.size(), 2);
+
+                const size_t size = out_.size() - start_;
+                for (size_t i = 0; i != 3; ++i)
+                    out_[start_ + header_offset_ + 1 + i] = static_cast<unsigned char>(size >> (8 * (2 - i)));
+                out_.resize(start_ + std::max<size_t>(size, block_size), 0);
+            }
+
+            size_t start() const { return start_; }
+            std::string const & last_key() const { return last_key_; }
+
+        private:
+            std::vector<unsigned char> & out_;
+            size_t start_;
+            size_t header_offset_;
+            std::vector<size_t> restarts_;
+            std::string last_key_;
+            std::vector<unsigned char> record_;
+            size_t entries_ = 0;
+        };
+
+        /// Writes the blocks of one section, remembering the last key and offset of each for the index
+        struct SectionWriter
+        {
+            SectionWriter(std::vector<unsigned char> & out, char type, uint32_t block_size)
+                : out_(out)
+                , type_(type)
+                , block_size_(block_size)
+            {}
+
+            /// @return false if the record does not fit into an empty block
+            bool add(std::string const & key, uint8_t extra, std::vector<unsigned char> const & value)
+            {
+                if (block_ && block_->add(key, extra, value, block_size_))
+                    return true;
+                finish();
+                // the first block holds the file header
+                block_.reset(new BlockWriter(out_, type_, out_.size() == header_size_v1 ? header_size_v1 : 0));
+                return block_->add(key, extra, value, block_size_);
+            }
+
+            void finish()
+            {
+                if (!block_)
+                    return;
+                blocks.emplace_back(block_->last_key(), block_->start());
+                block_->finish(block_size_);
+                block_.reset();
+            }
+
+            std::vector<std::pair<std::string, uint64_t>> blocks;
+
+        private:
+            std::vector<unsigned char> & out_;
+            char type_;
+            uint32_t block_size_;
+            std::unique_ptr<BlockWriter> block_;
+        };
+
+        int too_long(std::string const & key)
+        {
+            return set_error(GIT_ERROR_REFERENCE, "reference name '" + key + "' does not fit into a reftable block");
+        }
+    }
+
+    struct Table::Block
+    {
+        unsigned char const * data;     ///< start of the block; the first one starts with the file header
+        char type;
+        size_t records;                 ///< offsets relative to data
+        size_t records_end;
+        unsigned char const * restarts;
+        size_t restart_count;
+        size_t next;                    ///< file offset of the following block
+    };
+
+    struct Table::Cursor
+    {
+        unsigned char const * next;     ///< record after the current one
+        std::string key;
+        Record record;                  ///< of ref blocks
+        uint64_t position;              ///< of index blocks
+    };
+
+    Table::Table(const char * path)
+        : file_(path)
+        , path_(path)
+    {
+        if (!file_)
+            return;
+
+        unsigned char const * data = file_.data();
+        const size_t size = file_.size();
+        if (size < header_size_v1 || std::memcmp(data, "REFT", 4) != 0)
+            return;
+        if (data[4] == 1)
+            header_size_ = header_size_v1;
+        else if (data[4] == 2 && size >= header_size_v2 && get_be(data + header_size_v1, 4) == sha1_hash_id)
+            header_size_ = header_size_v2;
+        else
+            return;
+
+        const size_t footer_size = header_size_ + footer_fields_size;
+        if (size < header_size_ + footer_size)
+            return;
+        unsigned char const * footer = data + size - footer_size;
+        if (std::memcmp(footer, data, header_size_) != 0 || get_be(footer + footer_size - 4, 4) != crc32(footer, footer_size - 4))
+            return;
+
+        block_size_ = static_cast<uint32_t>(get_be(data + 5, 3));
+        min_update_index_ = get_be(data + 8, 8);
+        max_update_index_ = get_be(data + 16, 8);
+        ref_index_ = get_be(footer + header_size_, 8);
+        end_ = size - footer_size;
+        valid_ = ref_index_ < end_;
+    }
+
+    int Table::corrupt() const
+    {
+        return set_error(GIT_ERROR_REFERENCE, "corrupt reftable '" + path_ + "'");
+    }
+
+    int Table::block_at(size_t offset, Block & block) const
+    {
+        const size_t header_offset = offset == 0 ? header_size_ : 0;
+        if (offset >= end_ || end_ - offset < header_offset + block_header_size)
+            return GIT_ITEROVER;
+
+        block.data = file_.data() + offset;
+        block.type = static_cast<char>(block.data[header_offset]);
+        // log blocks are compressed, and nothing below reads them or object blocks
+        if (block.type != 'r' && block.type != 'i')
+            return GIT_ITEROVER;
+
+        const size_t size = static_cast<size_t>(get_be(block.data + header_offset + 1, 3));
+        block.records = header_offset + block_header_size;
+        if (size < block.records + 2 || size > end_ - offset)
+            return corrupt();
+        block.restart_count = static_cast<size_t>(get_be(block.data + size - 2, 2));
+        if (block.restart_count == 0 || (size - block.records - 2) / 3 < block.restart_count)
+            return corrupt();
+        block.records_end = size - 2 - 3 * block.restart_count;
+        block.restarts = block.data + block.records_end;
+        for (size_t i = 0; i != block.restart_count; ++i)
+        {
+            const size_t restart = static_cast<size_t>(get_be(block.restarts + 3 * i, 3));
+            if (restart < block.records || restart >= block.records_end)
+                return corrupt();
+        }
+
+        // padding is zeros; an unpadded table continues with the next block right away
+        size_t full_size = size;
+        if (block_size_ && size < block_size_ && (end_ - offset == size || block.data[size] == 0))
+            full_size = block_size_;
+        block.next = offset + full_size;
+        return 0;
+    }
+
+    bool Table::read_record(Block const & block, Cursor & cursor) const
+    {
+        unsigned char const *& p = cursor.next;
+        unsigned char const * end = block.data + block.records_end;
+
+        uint64_t prefix, suffix_and_type;
+        if (!get_varint(p, end, prefix) || !get_varint(p, end, suffix_and_type) || prefix > cursor.key.size())
+            return false;
+        const uint64_t suffix = suffix_and_type >> 3;
+        const uint8_t type = suffix_and_type & 7;
+        if (suffix > uint64_t(end - p))
+            return false;
+        cursor.key.resize(static_cast<size_t>(prefix));
+        cursor.key.append(reinterpret_cast<char const *>(p), static_cast<size_t>(suffix));
+        p += suffix;
+
+        if (block.type == 'i')
+            return type == 0 && get_varint(p, end, cursor.position);
+
+        Record & record = cursor.record;
+        uint64_t update_index_delta;
+        if (!get_varint(p, end, update_index_delta))
+            return false;
+        record.type = type;
+        record.update_index = min_update_index_ + update_index_delta;
+        record.id = {};
+        record.peeled = {};
+        record.target.clear();
+        switch (type)
+        {
+        case deletion:
+            return true;
+        case one_id:
+            return get_id(p, end, record.id);
+        case two_ids:
+            return get_id(p, end, record.id) && get_id(p, end, record.peeled);
+        case symref:
+        {
+            uint64_t size;
+            if (!get_varint(p, end, size) || size > uint64_t(end - p))
+                return false;
+            record.target.assign(reinterpret_cast<char const *>(p), static_cast<size_t>(size));
+            p += size;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    int Table::block_seek(Block const & block, std::string_view key, Cursor & cursor) const
+    {
+        auto restart = [&](size_t i) { return block.data + get_be(block.restarts + 3 * i, 3); };
+
+        // keys at restart points are stored whole: bisect for the first one above key
+        size_t lo = 0, hi = block.restart_count;
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            cursor.next = restart(mid);
+            cursor.key.clear();
+            if (!read_record(block, cursor))
+                return corrupt();
+            if (key < cursor.key)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+
+        cursor.next = restart(lo ? lo - 1 : 0);
+        cursor.key.clear();
+        while (cursor.next != block.data + block.records_end)
+        {
+            if (!read_record(block, cursor))
+                return corrupt();
+            if (!(cursor.key < key))
+                return 0;
+        }
+        return GIT_ITEROVER;
+    }
+
+    int Table::seek(std::string_view key, Block & block, Cursor & cursor) const
+    {
+        if (!ref_index_)
+        {
+            for (size_t offset = 0;; offset = block.next)
+            {
+                int error = block_at(offset, block);
+                if (!error && block.type != 'r')
+                    error = GIT_ITEROVER;
+                if (error)
+                    return error;
+                error = block_seek(block, key, cursor);
+                if (error != GIT_ITEROVER)
+                    return error;
+            }
+        }
+
+        // index records hold the last key of the block below them; the top level may span several blocks
+        size_t offset = static_cast<size_t>(ref_index_);
+        bool top = true;
+        while (true)
+        {
+            int error = block_at(offset, block);
+            if (top && offset != ref_index_ && (error == GIT_ITEROVER || (!error && block.type != 'i')))
+                return GIT_ITEROVER;
+            if (error)
+                return error == GIT_ITEROVER ? corrupt() : error;
+
+            error = block_seek(block, key, cursor);
+            if (error == GIT_ITEROVER && top)
+            {
+                offset = block.next;
+                continue;
+            }
+            if (error || block.type == 'r')
+                return error;
+
+            // children are written before their index
+            if (cursor.position >= offset)
+                return corrupt();
+            offset = static_cast<size_t>(cursor.position);
+            top = false;
+        }
+    }
+
+    int Table::find(std::string_view name, Record & record) const
+    {
+        Block block;
+        Cursor cursor;
+        if (int error = seek(name, block, cursor))
+            return error == GIT_ITEROVER ? GIT_ENOTFOUND : error;
+        if (cursor.key != name)
+            return GIT_ENOTFOUND;
+        record = std::move(cursor.record);
+        record.name = std::move(cursor.key);
+        return 0;
+    }
+
+    int Table::read_prefix(std::string_view prefix, std::vector<Record> & out) const
+    {
+        Block block;
+        Cursor cursor;
+        if (int error = seek(prefix, block, cursor))
+            return error == GIT_ITEROVER ? 0 : error;
+
+        while (starts_with(cursor.key, prefix))
+        {
+            out.push_back(cursor.record);
+            out.back().name = cursor.key;
+
+            if (cursor.next == block.data + block.records_end)
+            {
+                const int error = block_at(block.next, block);
+                if (error == GIT_ITEROVER || (!error && block.type != 'r'))
+                    return 0;
+                if (error)
+                    return error;
+                cursor.next = block.data + block.records;
+                cursor.key.clear();
+            }
+            if (!read_record(block, cursor))
+                return corrupt();
+        }
+        return 0;
+    }
+
+    int write_table(std::vector<Record> const & records, uint64_t min_update_index, uint64_t max_update_index,
+                    std::vector<unsigned char> & out, uint32_t block_size)
+    {
+        out.clear();
+        out.insert(out.end(), {'R', 'E', 'F', 'T', 1});
+        put_be(out, block_size, 3);
+        put_be(out, min_update_index, 8);
+        put_be(out, max_update_index, 8);
+
+        SectionWriter refs(out, 'r', block_size);
+        std::vector<unsigned char> value;
+        for (auto const & record : records)
+        {
+            value.clear();
+            put_varint(value, record.update_index - min_update_index);
+            if (record.type == one_id || record.type == two_ids)
+                put_id(value, record.id);
+            if (record.type == two_ids)
+                put_id(value, record.peeled);
+            if (record.type == symref)
+            {
+                put_varint(value, record.target.size());
+                value.insert(value.end(), record.target.begin(), record.target.end());
+            }
+            if (!refs.add(record.name, record.type, value))
+                return too_long(record.name);
+        }
+        refs.finish();
+
+        // each index level holds the last key of every block of the level below
+        uint64_t ref_index = 0;
+        auto level = std::move(refs.blocks);
+        while (level.size() > max_unindexed_blocks)
+        {
+            ref_index = out.size();
+            SectionWriter index(out, 'i', block_size);
+            for (auto const & entry : level)
+            {
+                value.clear();
+                put_varint(value, entry.second);
+                if (!index.add(entry.first, 0, value))
+                    return too_long(entry.first);
+            }
+            index.finish();
+            level = std::move(index.blocks);
+        }
+
+        const size_t footer = out.size();
+        const std::vector<unsigned char> header(out.begin(), out.begin() + header_size_v1);
+        out.insert(out.end(), header.begin(), header.end());
+        put_be(out, ref_index, 8);
+        put_be(out, 0, 8);  // no object blocks, no object index, no logs, no log index
+        put_be(out, 0, 8);
+        put_be(out, 0, 8);
+        put_be(out, 0, 8);
+        put_be(out, crc32(out.data() + footer, out.size() - footer), 4);
+        return 0;
+    }
+
+    /// Lock file of `tables.list`; the new list is written into it
+    struct ListLock
+    {
+        explicit ListLock(std::string path)
+            : path_(std::move(path))
+        {}
+
+        ~ListLock()
+        {
+            if (file_)
+            {
+                std::fclose(file_);
+                std::remove(path_.c_str());
+            }
+        }
+
+        int acquire()
+        {
+            file_ = std::fopen(path_.c_str(), "wbx");
+            if (file_)
+                return 0;
+            std::error_code ec;
+            if (fs::exists(path_, ec))
+                return set_error(GIT_ERROR_REFERENCE, "could not lock '" + path_ + "': file exists", GIT_ELOCKED);
+            return set_error(GIT_ERROR_OS, "could not create '" + path_ + "'");
+        }
+
+        int commit(std::string const & list, std::string const & target)
+        {
+            const bool written = std::fwrite(list.data(), 1, list.size(), file_) == list.size();
+            const bool closed = std::fclose(file_) == 0;
+            file_ = nullptr;
+            std::error_code ec;
+            if (written && closed)
+                fs::rename(path_, target, ec);
+            if (!written || !closed || ec)
+            {
+                std::remove(path_.c_str());
+                return set_error(GIT_ERROR_OS, "could not write '" + target + "'");
+            }
+            return 0;
+        }
+
+    private:
+        std::string path_;
+        FILE * file_ = nullptr;
+    };
+
+    Stack::Stack(std::string dir)
+        : dir_(std::move(dir))
+    {
+    }
+
+    bool Stack::exists(const char * commondir)
+    {
+        std::error_code ec;
+        return fs::is_directory(fs::path(commondir) / "reftable", ec);
+    }
+
+    int Stack::reload()
+    {
+        // a compaction may remove tables between reading the list and opening them
+        for (int attempt = 0;; ++attempt)
+        {
+            std::string list;
+            if (!read_file(dir_ + "/tables.list", list))
+            {
+                std::error_code ec;
+                if (fs::exists(dir_ + "/tables.list", ec))
+                    return set_error(GIT_ERROR_OS, "could not read '" + dir_ + "/tables.list'");
+                list.clear();
+            }
+            if (list == list_)
+                return 0;
+
+            std::vector<Entry> tables;
+            bool missing = false;
+            for (size_t pos = 0; pos < list.size() && !missing;)
+            {
+                size_t eol = list.find('\n', pos);
+                if (eol == std::string::npos)
+                    eol = list.size();
+                std::string name = list.substr(pos, eol - pos);
+                pos = eol + 1;
+                if (name.empty())
+                    continue;
+
+                auto it = std::find_if(tables_.begin(), tables_.end(), [&](Entry const & e) { return e.name == name; });
+                if (it != tables_.end())
+                {
+                    tables.push_back(*it);
+                    continue;
+                }
+                const std::string path = dir_ + "/" + name;
+                auto table = std::make_shared<Table const>(path.c_str());
+                if (!*table)
+                {
+                    std::error_code ec;
+                    missing = !fs::exists(path, ec);
+                    if (!missing || attempt == 2)
+                        return set_error(GIT_ERROR_REFERENCE, "could not read reftable '" + path + "'");
+                }
+                tables.push_back({ std::move(name), std::move(table) });
+            }
+            if (missing)
+                continue;
+
+            tables_ = std::move(tables);
+            list_ = std::move(list);
+            return 0;
+        }
+    }
+
+    int Stack::find(std::string_view name, Record & record) const
+    {
+        for (auto it = tables_.rbegin(); it != tables_.rend(); ++it)
+        {
+            const int error = it->table->find(name, record);
+            if (error == GIT_ENOTFOUND)
+                continue;
+            if (error)
+                return error;
+            return record.type == deletion ? GIT_ENOTFOUND : 0;
+        }
+        return GIT_ENOTFOUND;
+    }
+
+    int Stack::read_prefix(std::string_view prefix, std::vector<Record> & out) const
+    {
+        return merge(0, {}, prefix, false, out);
+    }
+
+    int Stack::name_conflict(std::string const & name, std::string const & ignored) const
+    {
+        Record record;
+        for (size_t slash = name.find('/'); slash != std::string::npos; slash = name.find('/', slash + 1))
+        {
+            const std::string dir = name.substr(0, slash);
+            const int error = dir == ignored ? GIT_ENOTFOUND : find(dir, record);
+            if (!error)
+                return set_error(GIT_ERROR_REFERENCE, "reference '" + name + "' collides with '" + dir + "'", GIT_EEXISTS);
+            if (error != GIT_ENOTFOUND)
+                return error;
+        }
+
+        std::vector<Record> below;
+        if (int error = read_prefix(name + "/", below))
+            return error;
+        for (auto const & other : below)
+        {
+            if (other.name != ignored)
+                return set_error(GIT_ERROR_REFERENCE, "reference '" + name + "' collides with '" + other.name + "'", GIT_EEXISTS);
+        }
+        return 0;
+    }
+
+    int Stack::merge(size_t first, std::vector<Record> extra, std::string_view prefix, bool keep_deletions,
+                     std::vector<Record> & out) const
+    {
+        // every table is sorted; merging them oldest first keeps newer records after older ones
+        std::vector<Record> all;
+        auto name_less = [](Record const & a, Record const & b) { return a.name < b.name; };
+        for (size_t i = first; i != tables_.size(); ++i)
+        {
+            const size_t middle = all.size();
+            if (int error = tables_[i].table->read_prefix(prefix, all))
+                return error;
+            std::inplace_merge(all.begin(), all.begin() + middle, all.end(), name_less);
+        }
+        const size_t middle = all.size();
+        for (auto & record : extra)
+        {
+            if (starts_with(record.name, prefix))
+                all.push_back(std::move(record));
+        }
+        std::inplace_merge(all.begin(), all.begin() + middle, all.end(), name_less);
+
+        for (size_t i = 0; i != all.size(); ++i)
+        {
+            if (i + 1 != all.size() && all[i + 1].name == all[i].name)
+                continue;
+            if (keep_deletions || all[i].type != deletion)
+                out.push_back(std::move(all[i]));
+        }
+        return 0;
+    }
+
+    int Stack::replace_top(size_t first, std::vector<Record> const & records, uint64_t min_update_index,
+                           uint64_t max_update_index, ListLock & lock)
+    {
+        std::vector<unsigned char> data;
+        if (int error = write_table(records, min_update_index, max_update_index, data))
+            return error;
+
+        char name[64];
+        snprintf(name, sizeof(name), "0x%012" PRIx64 "-0x%012" PRIx64 "-%08x.ref",
+                 min_update_index, max_update_index, static_cast<unsigned>(std::random_device()()));
+        const std::string path = dir_ + "/" + name;
+        FILE * file = std::fopen(path.c_str(), "wbx");
+        if (!file)
+            return set_error(GIT_ERROR_OS, "could not create '" + path + "'");
+        const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        if (std::fclose(file) != 0 || !written)
+        {
+            std::remove(path.c_str());
+            return set_error(GIT_ERROR_OS, "could not write '" + path + "'");
+        }
+
+        std::string list;
+        for (size_t i = 0; i != first; ++i)
+            list += tables_[i].name + "\n";
+        list += std::string(name) + "\n";
+        if (int error = lock.commit(list, dir_ + "/tables.list"))
+        {
+            std::remove(path.c_str());
+            return error;
+        }
+
+        // readers that still map the replaced tables keep them alive
+        for (size_t i = first; i != tables_.size(); ++i)
+            std::remove((dir_ + "/" + tables_[i].name).c_str());
+        return reload();
+    }
+
+    int Stack::add(std::vector<Record> records, Check const & check)
+    {
+        ListLock lock(dir_ + "/tables.list.lock");
+        int error = lock.acquire();
+        if (!error)
+            error = reload();
+        if (!error && check)
+            error = check(*this, records);
+        if (error)
+            return error;
+
+        std::sort(records.begin(), records.end(), [](Record const & a, Record const & b) { return a.name < b.name; });
+        const uint64_t update_index = tables_.empty() ? 1 : tables_.back().table->max_update_index() + 1;
+        for (auto & record : records)
+            record.update_index = update_index;
+
+        std::vector<unsigned char> data;
+        if ((error = write_table(records, update_index, update_index, data)))
+            return error;
+
+        // keep every table more than twice as large as all tables above it
+        size_t first = tables_.size();
+        uint64_t bytes = data.size();
+        while (first != 0 && tables_[first - 1].table->size() <= 2 * bytes)
+        {
+            --first;
+            bytes += tables_[first].table->size();
+        }
+        if (first == tables_.size())
+            return replace_top(first, records, update_index, update_index, lock);
+
+        std::vector<Record> merged;
+        if ((error = merge(first, std::move(records), {}, first != 0, merged)))
+            return error;
+        return replace_top(first, merged, tables_[first].table->min_update_index(), update_index, lock);
+    }
+
+    int Stack::compact()
+    {
+        ListLock lock(dir_ + "/tables.list.lock");
+        int error = lock.acquire();
+        if (!error)
+            error = reload();
+        if (error || tables_.size() < 2)
+            return error;
+
+        std::vector<Record> merged;
+        if ((error = merge(0, {}, {}, false, merged)))
+            return error;
+        return replace_top(0, merged, tables_.front().table->min_update_index(), tables_.back().table->max_update_index(), lock);
+    }
+}}}
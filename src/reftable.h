@@ -0,0 +1,152 @@
+#pragma once
+
+#include "file_mapping.h"
+
+#include <git2/oid.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct git_refdb_backend;
+
+namespace git {
+namespace internal {
+namespace reftable
+{
+    /// Value types of ref records
+    enum : uint8_t
+    {
+        deletion = 0,
+        one_id = 1,
+        two_ids = 2,    ///< id and the peeled id of an annotated tag
+        symref = 3
+    };
+
+    struct Record
+    {
+        std::string name;
+        uint8_t type = deletion;
+        git_oid id = {};
+        git_oid peeled = {};    ///< if type is two_ids
+        std::string target;     ///< if type is symref
+        uint64_t update_index = 0;
+    };
+
+    /// One immutable `.ref` file, version 1 or 2 with SHA-1 ids.
+    /// Only ref blocks and the ref index are read; logs and the object index are ignored.
+    struct Table
+    {
+        explicit Table(const char * path);
+
+        Table(Table const &) = delete;
+        Table & operator=(Table const &) = delete;
+
+        /// false if the file could not be mapped or is not a valid table
+        explicit operator bool() const { return valid_; }
+
+        uint64_t min_update_index() const { return min_update_index_; }
+        uint64_t max_update_index() const { return max_update_index_; }
+        size_t size() const { return file_.size(); }
+
+        /// Record of name, which may be a deletion
+        /// @return 0, GIT_ENOTFOUND if the table has no record of name, or an error
+        int find(std::string_view name, Record &) const;
+        /// Appends the records whose names start with prefix, in name order
+        int read_prefix(std::string_view prefix, std::vector<Record> &) const;
+
+    private:
+        struct Block;
+        struct Cursor;
+        /// @return 0, GIT_ITEROVER if there is no ref or index block at offset, or an error
+        int block_at(size_t offset, Block &) const;
+        bool read_record(Block const &, Cursor &) const;
+        /// Positions the cursor on the first record of the block not below key
+        /// @return 0, GIT_ITEROVER if all keys of the block are below it, or an error
+        int block_seek(Block const &, std::string_view key, Cursor &) const;
+        /// Positions the cursor on the first ref record not below key, through the index if there is one
+        int seek(std::string_view key, Block &, Cursor &) const;
+        int corrupt() const;
+
+        FileMapping file_;
+        std::string path_;
+        size_t header_size_ = 0;
+        uint32_t block_size_ = 0;
+        size_t end_ = 0;            ///< start of the footer
+        uint64_t ref_index_ = 0;
+        uint64_t min_update_index_ = 0;
+        uint64_t max_update_index_ = 0;
+        bool valid_ = false;
+    };
+
+    /// Encodes sorted records as a table with padded blocks, restart points every 16 records
+    /// and a ref index once there are more than 3 ref blocks, as git writes them
+    /// @return 0 or an error if a record does not fit into a block
+    int write_table(std::vector<Record> const & records, uint64_t min_update_index, uint64_t max_update_index,
+                    std::vector<unsigned char> & out, uint32_t block_size = 4096);
+
+    struct ListLock;
+
+    /// The tables listed in `reftable/tables.list`, oldest first. A newer record of a name
+    /// hides the older ones; deletions hide the name altogether.
+    struct Stack
+    {
+        /// @param dir the `reftable` directory
+        explicit Stack(std::string dir);
+
+        /// True if commondir holds a reftable stack
+        static bool exists(const char * commondir);
+
+        /// Rereads `tables.list` and maps tables added since the last call
+        int reload();
+
+        /// @return 0, GIT_ENOTFOUND or an error
+        int find(std::string_view name, Record &) const;
+        /// Live records whose names start with prefix, in name order
+        int read_prefix(std::string_view prefix, std::vector<Record> &) const;
+        /// A name can't be both a reference and a directory of references, like the files backend requires
+        /// @param ignored a reference that is about to be removed
+        /// @return 0, GIT_EEXISTS if name collides with another reference, or an error
+        int name_conflict(std::string const & name, std::string const & ignored = {}) const;
+
+        /// Called under the lock of `tables.list` with the stack reloaded; may fill in the records
+        using Check = std::function<int (Stack const &, std::vector<Record> & records)>;
+
+        /// Adds records as a new table on top of the stack, after check accepted the current state.
+        /// Small tables at the top are compacted with the new one, so that table sizes keep
+        /// growing geometrically from the top down.
+        /// @return 0, GIT_ELOCKED if `tables.list` is locked, the error of check, or another error
+        int add(std::vector<Record> records, Check const & check = {});
+        /// Merges all tables into one without deletions
+        int compact();
+
+    private:
+        struct Entry
+        {
+            std::string name;
+            std::shared_ptr<Table const> table;
+        };
+
+        /// Appends the newest records of tables [first, end) and extra, in name order
+        int merge(size_t first, std::vector<Record> extra, std::string_view prefix, bool keep_deletions,
+                  std::vector<Record> &) const;
+        /// Writes records as one table replacing tables [first, end), under the lock
+        int replace_top(size_t first, std::vector<Record> const & records, uint64_t min_update_index,
+                        uint64_t max_update_index, ListLock &);
+
+        std::string dir_;
+        std::string list_;
+        std::vector<Entry> tables_;
+    };
+
+    /// Refdb backend over the stack in `<commondir>/reftable`. Reflogs are not stored:
+    /// reading or writing a reflog fails, renaming or deleting one does nothing.
+    git_refdb_backend * new_refdb_backend(const char * commondir);
+
+    /// Allows libgit2 to open repositories with `extensions.refStorage`; called by the initializers
+    void allow_ref_storage_extension();
+}}}
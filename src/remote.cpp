@@ -1,6 +1,19 @@
 #include "git2cpp/remote.h"
+#include "git2cpp/error.h"
 
+#include "fetch_state.h"
+#include "metrics_span.h"
+
+#include <git2/buffer.h>
+#include <git2/odb.h>
+#include <git2/refs.h>
+#include <git2/refspec.h>
 #include <git2/remote.h>
+#include <git2/version.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace git
 {
@@ -14,47 +27,259 @@ namespace git
         return git_remote_pushurl(remote_.get());
     }
 
-    git_fetch_options fetch_options_from_callbacks(Remote::FetchCallbacks & callbacks)
+    namespace internal
     {
-        using FetchCallbacks = Remote::FetchCallbacks;
+        FetchState::FetchState(Remote::FetchCallbacks & callbacks)
+            : callbacks(callbacks)
+            , phase_start_(clock::now())
+        {
+        }
+
+        Remote::TransferRate FetchState::transfer_rate(git_indexer_progress const & stats)
+        {
+            using Phase = Remote::TransferRate::Phase;
+
+            const auto now = clock::now();
+            const bool resolving = stats.total_deltas != 0 && stats.received_objects == stats.total_objects;
+            if (resolving && phase_ == Phase::receiving)
+            {
+                phase_ = Phase::resolving_deltas;
+                phase_start_ = now;
+                done_at_phase_start_ = stats.indexed_deltas;
+            }
 
-        git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
-        opts.callbacks.payload = &callbacks;
+            Remote::TransferRate rate = {phase_, std::chrono::duration<double>(now - phase_start_).count(), 0, 0};
+            if (rate.seconds > 0)
+            {
+                if (phase_ == Phase::receiving)
+                {
+                    rate.objects_per_second = (stats.received_objects - done_at_phase_start_) / rate.seconds;
+                    rate.bytes_per_second = stats.received_bytes / rate.seconds;
+                }
+                else
+                {
+                    rate.objects_per_second = (stats.indexed_deltas - done_at_phase_start_) / rate.seconds;
+                }
+            }
+            return rate;
+        }
 
-        opts.callbacks.update_tips = [] (char const * refname, git_oid const * a, git_oid const * b, void * data)
+        git_fetch_options fetch_options(FetchState & state, Remote::FetchOptions const & options)
         {
-            auto callbacks = static_cast<FetchCallbacks*>(data);
-            callbacks->update_tips(refname, *a, *b);
-            return 0;
-        };
-        opts.callbacks.sideband_progress = [] (char const * str, int len, void * data)
+            git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
+            opts.callbacks.payload = &state;
+#if LIBGIT2_VER_MAJOR > 1 || LIBGIT2_VER_MINOR >= 7
+            opts.depth = options.depth();
+#else
+            if (options.depth() != 0)
+                throw fetch_depth_unsupported_error();
+#endif
+
+            opts.callbacks.update_tips = [] (char const * refname, git_oid const * a, git_oid const * b, void * data)
+            {
+                auto state = static_cast<FetchState*>(data);
+                state->callbacks.update_tips(refname, *a, *b);
+                return 0;
+            };
+            opts.callbacks.sideband_progress = [] (char const * str, int len, void * data)
+            {
+                auto state = static_cast<FetchState*>(data);
+                state->callbacks.sideband_progress(str, len);
+                return 0;
+            };
+            opts.callbacks.transfer_progress = [] (git_indexer_progress const * stats, void * data)
+            {
+                auto state = static_cast<FetchState*>(data);
+                state->callbacks.transfer_progress(*stats);
+                state->callbacks.transfer_rate(state->transfer_rate(*stats));
+                return 0;
+            };
+            opts.callbacks.credentials = [] (git_credential ** out, char const *url, char const * user_from_url, unsigned int allowed_types, void * data)
+            {
+                auto state = static_cast<FetchState*>(data);
+                auto cred = state->callbacks.acquire_cred(url, user_from_url, allowed_types);
+                if (!cred)
+                    return -1;
+                *out = cred;
+                return 0;
+            };
+            return opts;
+        }
+    }
+
+    void Remote::fetch(FetchCallbacks & callbacks, char const * reflog_message)
+    {
+        fetch(callbacks, FetchOptions(), reflog_message);
+    }
+
+    namespace
+    {
+        bool is_up_to_date(git_repository * repo, git_odb * odb, git_refspec const * spec, git_remote_head const & head)
         {
-            auto callbacks = static_cast<FetchCallbacks*>(data);
-            callbacks->sideband_progress(str, len);
-            return 0;
-        };
-        opts.callbacks.transfer_progress = [] (git_indexer_progress const * stats, void * data)
+            git_buf tracking = GIT_BUF_INIT;
+            if (git_refspec_transform(&tracking, spec, head.name) == 0)
+            {
+                git_oid local;
+                const bool same = git_reference_name_to_id(&local, repo, tracking.ptr) == 0
+                               && git_oid_equal(&local, &head.oid);
+                git_buf_dispose(&tracking);
+                return same;
+            }
+            // refspec without a destination: only the object itself matters
+            return git_odb_exists(odb, &head.oid) != 0;
+        }
+
+        /// True for an advertised tag that a plain fetch would create through tag auto-following
+        /// (or update, with --tags) even though no other ref moved
+        bool is_followed_tag(git_repository * repo, git_odb * odb, git_remote_autotag_option_t autotag,
+                             git_remote_head const * const * heads, size_t heads_count, size_t i)
         {
-            auto callbacks = static_cast<FetchCallbacks*>(data);
-            callbacks->transfer_progress(*stats);
-            return 0;
-        };
-        opts.callbacks.credentials = [] (git_credential ** out, char const *url, char const * user_from_url, unsigned int allowed_types, void * data)
+            git_remote_head const & head = *heads[i];
+            const std::string_view name = head.name;
+            const std::string_view peeled_suffix = "^{}";
+            if (autotag == GIT_REMOTE_DOWNLOAD_TAGS_NONE || name.compare(0, 10, "refs/tags/") != 0
+                || (name.size() >= peeled_suffix.size() && name.substr(name.size() - peeled_suffix.size()) == peeled_suffix))
+                return false;
+
+            // auto-following never touches a tag that exists here, whatever it points to
+            git_oid local;
+            if (git_reference_name_to_id(&local, repo, head.name) == 0)
+                return autotag == GIT_REMOTE_DOWNLOAD_TAGS_ALL && !git_oid_equal(&local, &head.oid);
+            if (autotag == GIT_REMOTE_DOWNLOAD_TAGS_ALL)
+                return true;
+
+            // auto-following only picks up tags whose target is already here;
+            // an annotated tag is advertised with its peeled target as "<name>^{}" right after it
+            git_oid const * target = &head.oid;
+            if (i + 1 != heads_count)
+            {
+                git_remote_head const & next = *heads[i + 1];
+                const std::string_view next_name = next.name;
+                if (next_name.size() == name.size() + peeled_suffix.size() && next_name.compare(0, name.size(), name) == 0)
+                    target = &next.oid;
+            }
+            return git_odb_exists(odb, target) != 0;
+        }
+
+        /// Builds one explicit refspec per advertised ref that moved since the last fetch.
+        /// Tags that the remote's auto-follow setting would pick up count as moved refs too.
+        /// @return raw error code
+        int changed_refspecs(git_remote * remote, git_remote_callbacks const & callbacks, git_proxy_options const & proxy,
+                             git_strarray const & custom_headers, std::vector<std::string> & refspecs, Remote::FetchStats & stats)
         {
-            auto callbacks = static_cast<FetchCallbacks*>(data);
-            auto cred = callbacks->acquire_cred(url, user_from_url, allowed_types);
-            if (!cred)
-                return -1;
-            *out = cred;
+            if (auto error = git_remote_connect(remote, GIT_DIRECTION_FETCH, &callbacks, &proxy, &custom_headers))
+                return error;
+
+            git_remote_head const ** heads;
+            size_t heads_count;
+            if (auto error = git_remote_ls(&heads, &heads_count, remote))
+                return error;
+
+            git_repository * repo = git_remote_owner(remote);
+            git_odb * odb;
+            if (auto error = git_repository_odb(&odb, repo))
+                return error;
+
+            stats.advertised_refs = heads_count;
+            const size_t specs_count = git_remote_refspec_count(remote);
+            const git_remote_autotag_option_t autotag = git_remote_autotag(remote);
+            for (size_t i = 0; i != heads_count; ++i)
+            {
+                git_remote_head const & head = *heads[i];
+                size_t j = 0;
+                for (; j != specs_count; ++j)
+                {
+                    git_refspec const * spec = git_remote_get_refspec(remote, j);
+                    if (git_refspec_direction(spec) != GIT_DIRECTION_FETCH || !git_refspec_src_matches(spec, head.name))
+                        continue;
+
+                    ++stats.matching_refs;
+                    if (!is_up_to_date(repo, odb, spec, head))
+                    {
+                        std::string refspec = git_refspec_force(spec) ? "+" : "";
+                        refspec += head.name;
+                        git_buf tracking = GIT_BUF_INIT;
+                        if (git_refspec_transform(&tracking, spec, head.name) == 0)
+                        {
+                            refspec += ':';
+                            refspec += tracking.ptr;
+                            git_buf_dispose(&tracking);
+                        }
+                        refspecs.push_back(std::move(refspec));
+                    }
+                    break;
+                }
+                if (j == specs_count && is_followed_tag(repo, odb, autotag, heads, heads_count, i))
+                {
+                    refspecs.push_back(std::string(head.name) + ':' + head.name);
+                    ++stats.matching_refs;
+                }
+            }
+            git_odb_free(odb);
+
+            stats.changed_refs = refspecs.size();
             return 0;
-        };
-        return opts;
+        }
     }
 
-    void Remote::fetch(FetchCallbacks & callbacks, char const * reflog_message)
+    Remote::FetchStats Remote::fetch(FetchCallbacks & callbacks, FetchOptions const & options, char const * reflog_message)
+    {
+        internal::Span span(metrics::Operation::fetch);
+        internal::FetchState state(callbacks);
+        const auto opts = internal::fetch_options(state, options);
+
+        FetchStats stats;
+        if (!options.only_changed_refs())
+        {
+            stats.error = git_remote_fetch(remote_.get(), nullptr, &opts, reflog_message);
+            stats.transferred = stats.error == 0;
+            return stats;
+        }
+
+        std::vector<std::string> refspecs;
+        stats.error = changed_refspecs(remote_.get(), opts.callbacks, opts.proxy_opts, opts.custom_headers, refspecs, stats);
+        if (stats.error != 0)
+        {
+            git_remote_disconnect(remote_.get());
+            return stats;
+        }
+
+        // the remote stays connected, so the advertisement above is reused by the fetch
+        if (refspecs.empty())
+        {
+            // nothing is wanted, so no pack is negotiated; FETCH_HEAD is still written
+            // and stale refs pruned, as a plain fetch would
+            stats.error = git_remote_fetch(remote_.get(), nullptr, &opts, reflog_message);
+            return stats;
+        }
+
+        std::vector<char *> strings;
+        strings.reserve(refspecs.size());
+        for (auto & refspec : refspecs)
+            strings.push_back(&refspec[0]);
+        const git_strarray refspecs_array = { strings.data(), strings.size() };
+        stats.error = git_remote_fetch(remote_.get(), &refspecs_array, &opts, reflog_message);
+        stats.transferred = stats.error == 0;
+        return stats;
+    }
+
+    Remote::FetchOptions & Remote::FetchOptions::fetch_depth(int depth)
+    {
+        depth_ = depth;
+        return *this;
+    }
+
+    Remote::FetchOptions & Remote::FetchOptions::unshallow()
+    {
+        // GIT_FETCH_DEPTH_UNSHALLOW
+        depth_ = 2147483647;
+        return *this;
+    }
+
+    Remote::FetchOptions & Remote::FetchOptions::fetch_only_changed_refs()
     {
-        const auto opts = fetch_options_from_callbacks(callbacks);
-        git_remote_fetch(remote_.get(), nullptr, &opts, reflog_message);
+        only_changed_refs_ = true;
+        return *this;
     }
 
     void Remote::Destroy::operator()(git_remote * remote) const
@@ -6,23 +6,79 @@
 #include "git2cpp/error.h"
 #include "git2cpp/internal/optional.h"
 
+#include "fetch_state.h"
+#include "metrics_span.h"
+#include "reftable.h"
+
 #include <git2/blame.h>
 #include <git2/blob.h>
 #include <git2/branch.h>
 #include <git2/commit.h>
+#include <git2/config.h>
 #include <git2/errors.h>
 #include <git2/merge.h>
+#include <git2/object.h>
+#include <git2/odb.h>
+#include <git2/refdb.h>
 #include <git2/reset.h>
 #include <git2/revwalk.h>
 #include <git2/submodule.h>
+#include <git2/sys/mempack.h>
+#include <git2/sys/odb_backend.h>
+#include <git2/sys/refdb_backend.h>
+#include <git2/sys/repository.h>
 #include <git2/tag.h>
 #include <git2/types.h>
+#include <git2/version.h>
 
+#include <algorithm>
 #include <cassert>
+#include <filesystem>
+#include <fstream>
 
 namespace git
 {
+    namespace repository_open
+    {
+        const flags none(0);
+        const flags no_search(GIT_REPOSITORY_OPEN_NO_SEARCH);
+        const flags cross_fs(GIT_REPOSITORY_OPEN_CROSS_FS);
+        const flags bare(GIT_REPOSITORY_OPEN_BARE);
+        const flags no_dotgit(GIT_REPOSITORY_OPEN_NO_DOTGIT);
+        const flags from_env(GIT_REPOSITORY_OPEN_FROM_ENV);
+    }
+
     const Repository::init_tag Repository::init;
+    const Repository::in_memory_tag Repository::in_memory;
+
+    namespace
+    {
+        /// Replaces the files backend of a repository whose refs are stored in a reftable
+        int use_reftable(git_repository * repo)
+        {
+            const char * commondir = git_repository_commondir(repo);
+            if (!commondir || !internal::reftable::Stack::exists(commondir))
+                return 0;
+            // per-worktree refs such as HEAD would live in the worktree's own stack
+            if (git_repository_is_worktree(repo))
+            {
+                git_error_set_str(GIT_ERROR_REPOSITORY, "linked worktrees of reftable repositories are not supported");
+                return GIT_EINVALID;
+            }
+
+            git_refdb * refdb;
+            if (auto error = git_refdb_new(&refdb, repo))
+                return error;
+            git_refdb_backend * backend = internal::reftable::new_refdb_backend(commondir);
+            auto error = git_refdb_set_backend(refdb, backend);
+            if (error)
+                backend->free(backend);
+            else
+                error = git_repository_set_refdb(repo, refdb);
+            git_refdb_free(refdb);
+            return error;
+        }
+    }
 
     Repository::Repository(git_repository * repo)
         : repo_(repo)
@@ -35,6 +91,8 @@ namespace git
         if (git_repository_open_ext(&repo, dir, 0, nullptr))
             throw repository_open_error(dir);
         repo_.reset(repo);
+        if (use_reftable(repo))
+            throw repository_open_error(dir);
     }
 
     Repository::Repository(std::string const & dir)
@@ -42,6 +100,16 @@ namespace git
     {
     }
 
+    Repository::Repository(const char * dir, repository_open::flags flags, const char * ceiling_dirs)
+    {
+        git_repository * repo;
+        if (git_repository_open_ext(&repo, dir, flags.value(), ceiling_dirs))
+            throw repository_open_error(dir ? dir : "$GIT_DIR");
+        repo_.reset(repo);
+        if (use_reftable(repo))
+            throw repository_open_error(dir ? dir : "$GIT_DIR");
+    }
+
     Repository::Repository(const char * dir, init_tag)
     {
         git_repository * repo;
@@ -62,11 +130,69 @@ namespace git
         repo_.reset(repo);
     }
 
-    git_fetch_options fetch_options_from_callbacks(Remote::FetchCallbacks &);
+    namespace
+    {
+        git_odb_backend * new_in_memory_backend()
+        {
+            git_odb_backend * mempack;
+            if (git_mempack_new(&mempack))
+                throw odb_open_error();
+            return mempack;
+        }
+    }
+
+    Repository::Repository(in_memory_tag)
+    {
+        git_repository * repo;
+        if (git_repository_new(&repo))
+            throw repository_init_error("<in-memory>");
+        repo_.reset(repo);
+
+        git_odb * odb;
+        if (git_odb_new(&odb))
+            throw odb_open_error();
+        git_odb_backend * mempack = new_in_memory_backend();
+        if (git_odb_add_backend(odb, mempack, 1))
+        {
+            // the odb only owns backends it has accepted
+            mempack->free(mempack);
+            git_odb_free(odb);
+            throw odb_open_error();
+        }
+        const int error = git_repository_set_odb(repo, odb);
+        git_odb_free(odb);
+        if (error)
+            throw odb_open_error();
+        in_memory_odb_ = true;
+    }
+
+    void Repository::add_in_memory_odb()
+    {
+        git_odb * odb;
+        if (git_repository_odb(&odb, repo_.get()))
+            throw odb_open_error();
+        // above the priorities of the loose (1) and pack (2) backends
+        git_odb_backend * mempack = new_in_memory_backend();
+        const int error = git_odb_add_backend(odb, mempack, 1000);
+        git_odb_free(odb);
+        if (error)
+        {
+            mempack->free(mempack);
+            throw odb_open_error();
+        }
+        in_memory_odb_ = true;
+    }
 
     Repository Repository::clone(const char * url, const char* path, git_checkout_options const & checkout_opts, Remote::FetchCallbacks & fetch_callbacks)
     {
-        const git_clone_options clone_opts = { GIT_CLONE_OPTIONS_VERSION, checkout_opts, fetch_options_from_callbacks(fetch_callbacks) };
+        return clone(url, path, checkout_opts, fetch_callbacks, Remote::FetchOptions());
+    }
+
+    Repository Repository::clone(const char * url, const char* path, git_checkout_options const & checkout_opts, Remote::FetchCallbacks & fetch_callbacks,
+                                 Remote::FetchOptions const & fetch_opts)
+    {
+        internal::FetchState fetch_state(fetch_callbacks);
+        const git_clone_options clone_opts = { GIT_CLONE_OPTIONS_VERSION, checkout_opts, internal::fetch_options(fetch_state, fetch_opts) };
         git_repository *cloned_repo = nullptr;
         if (auto error = git_clone(&cloned_repo, url, path, &clone_opts))
         {
@@ -83,27 +209,96 @@ namespace git
         return git_repository_is_bare(repo_.get()) != 0;
     }
 
+    bool Repository::is_shallow() const
+    {
+        return git_repository_is_shallow(repo_.get()) == 1;
+    }
+
     Signature Repository::signature() const
     {
         return Signature(repo_.get());
     }
 
+    git_object * Repository::lookup_cached(git_oid const & oid, git_object_t type) const
+    {
+        if (cache_)
+        {
+            auto obj = cache_->get(oid, type);
+            internal::count_cache(obj != nullptr);
+            if (obj)
+                return obj;
+        }
+
+        git_object * obj;
+        if (git_object_lookup(&obj, repo_.get(), &oid, type))
+            return nullptr;
+        if (cache_)
+            cache_->put(obj);
+        return obj;
+    }
+
+    void Repository::enable_object_cache(ObjectCache::Budget const & budget)
+    {
+        cache_.reset(new ObjectCache(budget));
+    }
+
     Commit Repository::commit_lookup(git_oid const & oid) const
     {
-        git_commit * commit;
-        if (git_commit_lookup(&commit, repo_.get(), &oid))
-            throw commit_lookup_error(oid);
+        internal::Span span(metrics::Operation::commit_lookup);
+        if (auto obj = lookup_cached(oid, GIT_OBJECT_COMMIT))
+            return {reinterpret_cast<git_commit *>(obj), *this};
         else
-            return {commit, *this};
+            throw commit_lookup_error(oid);
+    }
+
+    CommitView Repository::commit_view(git_oid const & oid) const
+    {
+        return CommitView(repo_.get(), oid, shallow_grafts());
+    }
+
+    CommitView Repository::commit_view(git_oid const & oid, ShallowGrafts const & shallow) const
+    {
+        return CommitView(repo_.get(), oid, shallow);
+    }
+
+    ShallowGrafts Repository::shallow_grafts() const
+    {
+        ShallowGrafts res;
+#if LIBGIT2_VER_MAJOR > 1 || LIBGIT2_VER_MINOR >= 7
+        const char * commondir = git_repository_commondir(repo_.get());
+        if (!commondir)
+            return res;
+
+        std::ifstream in(std::string(commondir) + "shallow");
+        std::string line;
+        while (std::getline(in, line))
+        {
+            git_oid id;
+            if (line.size() >= GIT_OID_HEXSZ && !git_oid_fromstrn(&id, line.data(), GIT_OID_HEXSZ))
+                res.ids.push_back(id);
+        }
+        std::sort(res.ids.begin(), res.ids.end(), [](git_oid const & a, git_oid const & b) { return git_oid_cmp(&a, &b) < 0; });
+#endif
+        return res;
     }
 
     Tree Repository::tree_lookup(git_oid const & oid) const
     {
-        git_tree * tree;
-        if (git_tree_lookup(&tree, repo_.get(), &oid))
-            throw tree_lookup_error(oid);
+        internal::Span span(metrics::Operation::tree_lookup);
+        if (auto obj = lookup_cached(oid, GIT_OBJECT_TREE))
+            return {reinterpret_cast<git_tree *>(obj), *this};
         else
-            return {tree, *this};
+            throw tree_lookup_error(oid);
+    }
+
+    TreeBuilder Repository::tree_builder() const
+    {
+        return TreeBuilder(repo_.get(), *this, nullptr);
+    }
+
+    TreeBuilder Repository::tree_builder(Tree const & base) const
+    {
+        return TreeBuilder(repo_.get(), *this, base.ptr());
     }
 
     Tag Repository::tag_lookup(git_oid const & oid) const
@@ -117,11 +312,15 @@ namespace git
 
     Blob Repository::blob_lookup(git_oid const & oid) const
     {
-        git_blob * blob;
-        if (git_blob_lookup(&blob, repo_.get(), &oid))
-            throw blob_lookup_error(oid);
-        else
+        internal::Span span(metrics::Operation::blob_lookup);
+        if (auto obj = lookup_cached(oid, GIT_OBJECT_BLOB))
+        {
+            auto blob = reinterpret_cast<git_blob *>(obj);
+            internal::count_inflated(git_blob_rawsize(blob));
             return Blob(blob);
+        }
+        else
+            throw blob_lookup_error(oid);
     }
 
     Revspec Repository::revparse(const char * spec) const
@@ -146,6 +345,13 @@ namespace git
         return Index(repo_.get());
     }
 
+    IndexView Repository::index_view() const
+    {
+        if (!path())
+            throw index_open_error();
+        return IndexView((std::string(path()) + "index").c_str());
+    }
+
     Odb Repository::odb() const
     {
         return Odb(repo_.get());
@@ -335,6 +541,7 @@ namespace git
 
     Status Repository::status(Status::Options const & opts) const
     {
+        internal::Span span(metrics::Operation::status);
         return Status(repo_.get(), opts);
     }
 
@@ -343,6 +550,137 @@ namespace git
         return static_cast<git_repository_state_t>(git_repository_state(repo_.get()));
     }
 
+    RefSnapshot Repository::ref_snapshot() const
+    {
+        const char * commondir = git_repository_commondir(repo_.get());
+        if (!commondir)
+            throw refs_read_error("<in-memory repository>");
+        return RefSnapshot(commondir);
+    }
+
+    int Repository::compress_refs()
+    {
+        git_refdb * refdb;
+        if (auto error = git_repository_refdb(&refdb, repo_.get()))
+            return error;
+        auto const error = git_refdb_compress(refdb);
+        git_refdb_free(refdb);
+        return error;
+    }
+
+    int Repository::convert_refs_to_reftable()
+    {
+        namespace fs = std::filesystem;
+        namespace reftable = internal::reftable;
+
+        const char * commondir = git_repository_commondir(repo_.get());
+        if (!commondir)
+        {
+            git_error_set_str(GIT_ERROR_REFERENCE, "an in-memory repository has no refs to convert");
+            return GIT_ENOTFOUND;
+        }
+        if (reftable::Stack::exists(commondir))
+        {
+            git_error_set_str(GIT_ERROR_REFERENCE, "the refs are stored in a reftable already");
+            return GIT_EEXISTS;
+        }
+        const fs::path dir(commondir);
+        std::error_code ec;
+        if (git_repository_is_worktree(repo_.get()) || (fs::exists(dir / "worktrees", ec) && !fs::is_empty(dir / "worktrees", ec)))
+        {
+            git_error_set_str(GIT_ERROR_REFERENCE, "repositories with linked worktrees can not be converted");
+            return GIT_EINVALID;
+        }
+
+        std::vector<reftable::Record> records;
+        git_reference * head;
+        if (auto error = git_reference_lookup(&head, repo_.get(), "HEAD"))
+            return error;
+        records.emplace_back();
+        records.back().name = "HEAD";
+        if (git_reference_type(head) == GIT_REFERENCE_SYMBOLIC)
+        {
+            records.back().type = reftable::symref;
+            records.back().target = git_reference_symbolic_target(head);
+        }
+        else
+        {
+            records.back().type = reftable::one_id;
+            records.back().id = *git_reference_target(head);
+        }
+        git_reference_free(head);
+
+        try
+        {
+            for (auto const & ref : RefSnapshot(commondir))
+            {
+                reftable::Record record;
+                record.name = std::string(ref.name);
+                if (!ref.symbolic_target.empty())
+                {
+                    record.type = reftable::symref;
+                    record.target = std::string(ref.symbolic_target);
+                }
+                else
+                {
+                    record.type = ref.has_peeled ? reftable::two_ids : reftable::one_id;
+                    record.id = ref.id;
+                    record.peeled = ref.peeled;
+                }
+                records.push_back(std::move(record));
+            }
+        }
+        catch (refs_read_error const & e)
+        {
+            git_error_set_str(GIT_ERROR_REFERENCE, e.what());
+            return GIT_ERROR;
+        }
+
+        fs::create_directory(dir / "reftable", ec);
+        if (ec)
+        {
+            git_error_set_str(GIT_ERROR_OS, ("could not create '" + (dir / "reftable").string() + "'").c_str());
+            return GIT_ERROR;
+        }
+        reftable::Stack stack((dir / "reftable").string());
+        if (auto error = stack.add(std::move(records)))
+            return error;
+
+        git_config * config;
+        if (auto error = git_repository_config(&config, repo_.get()))
+            return error;
+        auto error = git_config_set_int32(config, "core.repositoryformatversion", 1);
+        if (!error)
+            error = git_config_set_string(config, "extensions.refStorage", "reftable");
+        git_config_free(config);
+        if (error)
+            return error;
+
+        // what git leaves for tools that don't know the format: no refs, and a HEAD
+        // that is not a valid branch
+        fs::remove(dir / "packed-refs", ec);
+        fs::remove_all(dir / "refs", ec);
+        fs::create_directory(dir / "refs", ec);
+        std::ofstream(dir / "refs" / "heads", std::ios::binary) << "this repository uses the reftable format\n";
+        std::ofstream(dir / "HEAD", std::ios::binary) << "ref: refs/heads/.invalid\n";
+
+        return use_reftable(repo_.get());
+    }
+
+    RefTransaction Repository::ref_transaction()
+    {
+        return RefTransaction(repo_.get());
+    }
+
+    ChangedPathFilters Repository::changed_path_filters() const
+    {
+        const char * commondir = git_repository_commondir(repo_.get());
+        if (!commondir)
+            return ChangedPathFilters();
+        const std::string objects_dir = std::string(commondir) + "objects";
+        return ChangedPathFilters(objects_dir.c_str());
+    }
+
     StrArray Repository::reference_list() const
     {
         git_strarray str_array;
@@ -364,6 +702,11 @@ namespace git
         return git_repository_path(repo_.get());
     }
 
+    const char * Repository::commondir() const
+    {
+        return git_repository_commondir(repo_.get());
+    }
+
     const char * Repository::workdir() const
     {
         return git_repository_workdir(repo_.get());
@@ -441,6 +784,7 @@ namespace git
 
     Diff Repository::diff(Tree & a, Tree & b, git_diff_options const & opts) const
     {
+        internal::Span span(metrics::Operation::diff);
         git_diff * diff;
         auto op_res = git_diff_tree_to_tree(&diff, repo_.get(), a.ptr(), b.ptr(), &opts);
         assert(op_res == 0);
@@ -449,6 +793,7 @@ namespace git
 
     Diff Repository::diff_to_index(Tree & t, git_diff_options const & opts) const
     {
+        internal::Span span(metrics::Operation::diff);
         git_diff * diff;
         auto op_res = git_diff_tree_to_index(&diff, repo_.get(), t.ptr(), nullptr, &opts);
         assert(op_res == 0);
@@ -457,6 +802,7 @@ namespace git
 
     Diff Repository::diff_to_workdir(Tree & t, git_diff_options const & opts) const
     {
+        internal::Span span(metrics::Operation::diff);
         git_diff * diff;
         auto op_res = git_diff_tree_to_workdir(&diff, repo_.get(), t.ptr(), &opts);
         assert(op_res == 0);
@@ -465,6 +811,7 @@ namespace git
 
     Diff Repository::diff_to_workdir_with_index(Tree & t, git_diff_options const & opts) const
     {
+        internal::Span span(metrics::Operation::diff);
         git_diff * diff;
         auto op_res = git_diff_tree_to_workdir_with_index(&diff, repo_.get(), t.ptr(), &opts);
         assert(op_res == 0);
@@ -473,6 +820,7 @@ namespace git
 
     Diff Repository::diff_index_to_workdir(git_diff_options const & opts) const
     {
+        internal::Span span(metrics::Operation::diff);
         git_diff * diff;
         auto op_res = git_diff_index_to_workdir(&diff, repo_.get(), nullptr, &opts);
         assert(op_res == 0);
@@ -582,6 +930,7 @@ namespace git
 
     Blame Repository::blame_file(const char* path, git_blame_options const& options)
     {
+        internal::Span span(metrics::Operation::blame_file);
         git_blame * blame;
         const auto err = git_blame_file(
             &blame, repo_.get(), path,
@@ -593,11 +942,18 @@ namespace git
     }
 
     internal::optional<std::string> Repository::discover(const char * start_path)
+    {
+        return discover(start_path, false, nullptr);
+    }
+
+    internal::optional<std::string> Repository::discover(const char * start_path, bool across_fs, const char * ceiling_dirs)
     {
         git_buf buf = GIT_BUF_INIT;
-        if (git_repository_discover(&buf, start_path, 0, nullptr))
+        if (git_repository_discover(&buf, start_path, across_fs, ceiling_dirs))
             return internal::none;
-        return std::string(buf.ptr, buf.size);
+        std::string res(buf.ptr, buf.size);
+        git_buf_dispose(&buf);
+        return res;
     }
 
     void Repository::Destroy::operator() (git_repository* repo) const
@@ -0,0 +1,108 @@
+#include "git2cpp/repository_pool.h"
+#include "git2cpp/error.h"
+
+#include <filesystem>
+
+namespace git
+{
+    namespace
+    {
+        std::chrono::nanoseconds mtime(std::filesystem::path const & path)
+        {
+            std::error_code ec;
+            const auto time = std::filesystem::last_write_time(path, ec);
+            return ec ? std::chrono::nanoseconds::zero()
+                      : std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch());
+        }
+    }
+
+    bool RepositoryPool::Stamp::operator==(Stamp const & other) const
+    {
+        return config == other.config && packed_refs == other.packed_refs && packs == other.packs;
+    }
+
+    RepositoryPool::Stamp RepositoryPool::stamp(std::string const & commondir)
+    {
+        // loose refs are re-read by libgit2 on every lookup, so they need no stamp;
+        // adding or removing a pack changes the mtime of its directory.
+        // All of these live in the common directory, which worktrees share.
+        const std::filesystem::path dir(commondir);
+        return { mtime(dir / "config"), mtime(dir / "packed-refs"), mtime(dir / "objects" / "pack") };
+    }
+
+    RepositoryPool::RepositoryPool(size_t max_idle)
+        : max_idle_(max_idle)
+    {
+    }
+
+    RepositoryPool::Lease RepositoryPool::acquire(std::string const & path)
+    {
+        // declared before the lock, so outdated handles are closed after unlocking
+        std::vector<Idle> stale;
+        std::unique_lock<std::mutex> lock(mutex_);
+        Slot & slot = slots_[path];
+        if (!slot.commondir.empty())
+        {
+            const std::string commondir = slot.commondir;
+            lock.unlock();
+            const Stamp current = stamp(commondir);
+            lock.lock();
+
+            while (!slot.idle.empty())
+            {
+                Idle idle = std::move(slot.idle.back());
+                slot.idle.pop_back();
+                if (idle.stamp == current)
+                    return Lease(*this, slot, std::move(idle.repo), current);
+                stale.push_back(std::move(idle));
+            }
+        }
+        lock.unlock();
+        stale.clear();
+
+        auto repo = std::make_unique<Repository>(path);
+        if (!repo->commondir())
+            throw repository_open_error(path);
+        const std::string commondir = repo->commondir();
+        // taken after opening, so a change in between at worst causes one extra reopen
+        const Stamp current = stamp(commondir);
+
+        lock.lock();
+        if (slot.commondir.empty())
+            slot.commondir = commondir;
+        return Lease(*this, slot, std::move(repo), current);
+    }
+
+    void RepositoryPool::clear()
+    {
+        // declared before the lock, so the handles are closed after unlocking
+        std::vector<Idle> dropped;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto & slot : slots_)
+        {
+            for (auto & idle : slot.second.idle)
+                dropped.push_back(std::move(idle));
+            slot.second.idle.clear();
+        }
+    }
+
+    RepositoryPool::Lease::Lease(RepositoryPool & pool, Slot & slot, std::unique_ptr<Repository> repo, Stamp stamp)
+        : pool_(&pool)
+        , slot_(&slot)
+        , repo_(std::move(repo))
+        , stamp_(stamp)
+    {
+    }
+
+    RepositoryPool::Lease::~Lease()
+    {
+        if (!repo_)
+            return;
+
+        // declared before the lock, so a handle that is not kept is closed after unlocking
+        std::unique_ptr<Repository> repo = std::move(repo_);
+        std::lock_guard<std::mutex> lock(pool_->mutex_);
+        if (slot_->idle.size() < pool_->max_idle_)
+            slot_->idle.push_back(Idle{ std::move(repo), stamp_ });
+    }
+}
@@ -3,6 +3,12 @@
 #include "git2cpp/repo.h"
 
 #include <git2/revwalk.h>
+#include <git2/tree.h>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
 
 namespace git
 {
@@ -17,21 +23,268 @@ namespace git
         }
     }
 
+    namespace
+    {
+        struct OidHash
+        {
+            size_t operator() (git_oid const & oid) const
+            {
+                size_t hash;
+                std::memcpy(&hash, oid.id, sizeof(hash));
+                return hash;
+            }
+        };
+
+        struct OidEqual
+        {
+            bool operator() (git_oid const & a, git_oid const & b) const
+            {
+                return git_oid_equal(&a, &b) != 0;
+            }
+        };
+
+        struct TreeDeleter
+        {
+            void operator() (git_tree * tree) const { git_tree_free(tree); }
+        };
+        typedef std::unique_ptr<git_tree, TreeDeleter> tree_ptr;
+
+        tree_ptr lookup(git_repository * repo, git_oid const & id)
+        {
+            git_tree * tree;
+            if (git_tree_lookup(&tree, repo, &id))
+                throw tree_lookup_error(id);
+            return tree_ptr(tree);
+        }
+
+        struct Entry
+        {
+            git_oid id;
+            git_filemode_t mode;
+        };
+
+        internal::optional<Entry> entry(git_repository * repo, git_oid const * tree, std::string const & name)
+        {
+            if (!tree)
+                return internal::none;
+            auto t = lookup(repo, *tree);
+            auto e = git_tree_entry_byname(t.get(), name.c_str());
+            if (!e)
+                return internal::none;
+            return Entry{*git_tree_entry_id(e), git_tree_entry_filemode(e)};
+        }
+
+        /// Whether two trees (null for a missing one) have the same entry at `path`.
+        /// Descends one level at a time and stops at the first subtree both sides share.
+        bool same_at(git_repository * repo, git_oid const * a, git_oid const * b, std::string const & path)
+        {
+            internal::optional<Entry> a_entry, b_entry;
+            for (size_t begin = 0;;)
+            {
+                if (!a && !b)
+                    return true;
+                if (a && b && git_oid_equal(a, b))
+                    return true;
+
+                const size_t end = path.find('/', begin);
+                const std::string name = path.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+                a_entry = entry(repo, a, name);
+                b_entry = entry(repo, b, name);
+
+                if (end == std::string::npos)
+                {
+                    if (!a_entry || !b_entry)
+                        return !a_entry && !b_entry;
+                    return git_oid_equal(&a_entry->id, &b_entry->id) && a_entry->mode == b_entry->mode;
+                }
+
+                // only subtrees can hold the rest of the path
+                a = a_entry && a_entry->mode == GIT_FILEMODE_TREE ? &a_entry->id : nullptr;
+                b = b_entry && b_entry->mode == GIT_FILEMODE_TREE ? &b_entry->id : nullptr;
+                begin = end + 1;
+            }
+        }
+    }
+
+    struct RevWalker::PathLimit
+    {
+        PathLimit(Repository const & repo, git_repository * raw_repo, bool full_history)
+            : repo(repo)
+            , raw_repo(raw_repo)
+            , full_history(full_history)
+        {}
+
+        Repository const & repo;
+        git_repository * raw_repo;
+        std::vector<std::string> paths;
+        bool full_history;
+
+        // loaded when the walk starts
+        bool started = false;
+        internal::optional<ChangedPathFilters> filters;
+        std::vector<ChangedPathFilters::Path> keys;
+        ShallowGrafts const * shallow = nullptr;
+
+        // parents of the commits walked so far, true if they are on the simplified history
+        std::unordered_map<git_oid, bool, OidHash, OidEqual> followed;
+
+        // in reverse order the whole walk is done upfront
+        std::vector<git_oid> reversed;
+
+        void start(ShallowGrafts const & grafts)
+        {
+            started = true;
+            shallow = &grafts;
+            internal::emplace(filters, repo.changed_path_filters());
+            if (!filters->size())
+                filters = internal::none;
+            for (auto const & path : paths)
+                keys.emplace_back(path);
+        }
+
+        bool same(CommitView const & commit, git_oid const * parent_tree, bool first_parent) const
+        {
+            if (first_parent && filters)
+            {
+                bool unchanged = true;
+                for (auto const & key : keys)
+                    unchanged = unchanged && filters->maybe_changed(commit.id(), key) == ChangedPathFilters::Answer::no;
+                if (unchanged)
+                    return true;
+            }
+
+            const git_oid tree = commit.tree_id();
+            for (auto const & path : paths)
+            {
+                if (!same_at(raw_repo, &tree, parent_tree, path))
+                    return false;
+            }
+            return true;
+        }
+
+        /// Trees of the parents that are present; a parent beyond a shallow boundary
+        /// is missing and treated as no parent at all, like git does
+        std::vector<std::pair<git_oid, git_oid>> parent_trees(CommitView const & commit, size_t parents) const
+        {
+            std::vector<std::pair<git_oid, git_oid>> res;
+            res.reserve(parents);
+            for (size_t i = 0; i != parents; ++i)
+            {
+                const git_oid parent = commit.parent_id(i);
+                try
+                {
+                    res.emplace_back(parent, repo.commit_view(parent, *shallow).tree_id());
+                }
+                catch (commit_lookup_error const &)
+                {
+                }
+            }
+            return res;
+        }
+
+        void follow(git_oid const & parent, bool on_history)
+        {
+            auto res = followed.emplace(parent, on_history);
+            if (!res.second && on_history)
+                res.first->second = true;
+        }
+
+        /// Decides whether the commit is shown and which of its parents are followed;
+        /// all children of a commit must have been processed before it
+        bool process(CommitView const & commit, bool first_parent_only)
+        {
+            auto it = followed.find(commit.id());
+            // commits that are nobody's parent yet are where the walk starts
+            const bool on_history = it == followed.end() || it->second;
+            if (it != followed.end())
+                followed.erase(it);
+
+            const size_t parents = first_parent_only ? std::min<size_t>(commit.parents_num(), 1) : commit.parents_num();
+            if (!on_history)
+            {
+                for (size_t i = 0; i != parents; ++i)
+                    follow(commit.parent_id(i), false);
+                return false;
+            }
+
+            const auto trees = parent_trees(commit, parents);
+            if (trees.empty())
+                return !same(commit, nullptr, false);
+
+            // changed-path filters are computed against the first parent only
+            const git_oid first_parent = commit.parent_id(0);
+            size_t same_count = 0;
+            for (size_t i = 0; i != trees.size(); ++i)
+            {
+                if (!same(commit, &trees[i].second, git_oid_equal(&trees[i].first, &first_parent) != 0))
+                    continue;
+                ++same_count;
+                if (!full_history)
+                {
+                    // history is simplified to the parent with the same content
+                    for (size_t j = 0; j != trees.size(); ++j)
+                        follow(trees[j].first, j == i);
+                    return false;
+                }
+            }
+
+            for (auto const & parent : trees)
+                follow(parent.first, true);
+            return same_count != trees.size();
+        }
+    };
+
+    void RevWalker::DestroyPathLimit::operator()(PathLimit * paths) const
+    {
+        delete paths;
+    }
+
     void RevWalker::Destroy::operator()(git_revwalk* walker) const
     {
         git_revwalk_free(walker);
     }
 
-    void RevWalker::sort(revwalker::sorting::type s)
+    void RevWalker::apply_sorting()
     {
+        // path limiting needs children before parents, see PathLimit::process
+        auto s = paths_ ? (sorting_ & ~revwalker::sorting::reverse) | revwalker::sorting::topological : sorting_;
         git_revwalk_sorting(walker_.get(), s.value());
     }
 
+    void RevWalker::sort(revwalker::sorting::type s)
+    {
+        sorting_ = s;
+        apply_sorting();
+    }
+
     void RevWalker::simplify_first_parent()
     {
+        first_parent_ = true;
         git_revwalk_simplify_first_parent(walker_.get());
     }
 
+    void RevWalker::push_path(std::string path)
+    {
+        while (!path.empty() && path.back() == '/')
+            path.pop_back();
+
+        if (paths_ && paths_->started)
+            throw revwalk_started_error();
+        if (!paths_)
+        {
+            paths_.reset(new PathLimit(*repo_, git_revwalk_repository(walker_.get()), full_history_));
+            apply_sorting();
+        }
+        paths_->paths.push_back(std::move(path));
+    }
+
+    void RevWalker::full_history()
+    {
+        full_history_ = true;
+        if (paths_)
+            paths_->full_history = true;
+    }
+
     void RevWalker::push_head() const
     {
         if (git_revwalk_push_head(walker_.get()))
@@ -50,19 +303,74 @@ namespace git
             throw non_commit_object_error(obj);
     }
 
+    bool RevWalker::next_id(git_oid & oid) const
+    {
+        if (!paths_)
+            return git_revwalk_next(&oid, walker_.get()) == 0;
+
+        PathLimit & paths = *paths_;
+        if (!paths.started)
+        {
+            paths.start(shallow());
+            if (sorting_ & revwalker::sorting::reverse)
+            {
+                while (git_revwalk_next(&oid, walker_.get()) == 0)
+                {
+                    if (paths.process(repo_->commit_view(oid, shallow()), first_parent_))
+                        paths.reversed.push_back(oid);
+                }
+            }
+        }
+
+        if (sorting_ & revwalker::sorting::reverse)
+        {
+            if (paths.reversed.empty())
+                return false;
+            oid = paths.reversed.back();
+            paths.reversed.pop_back();
+            return true;
+        }
+
+        while (git_revwalk_next(&oid, walker_.get()) == 0)
+        {
+            if (paths.process(repo_->commit_view(oid, shallow()), first_parent_))
+                return true;
+        }
+        return false;
+    }
+
     Commit RevWalker::next() const
     {
         git_oid oid;
-        if (git_revwalk_next(&oid, walker_.get()) == 0)
+        if (next_id(oid))
             return repo_->commit_lookup(oid);
         else
             return Commit();
     }
 
+    CommitView RevWalker::next_view() const
+    {
+        git_oid oid;
+        if (next_id(oid))
+            return repo_->commit_view(oid, shallow());
+        else
+            return CommitView();
+    }
+
+    ShallowGrafts const & RevWalker::shallow() const
+    {
+        if (!shallow_read_)
+        {
+            shallow_ = repo_->shallow_grafts();
+            shallow_read_ = true;
+        }
+        return shallow_;
+    }
+
     bool RevWalker::next(char * id_buffer) const
     {
         git_oid oid;
-        bool valid = (git_revwalk_next(&oid, walker_.get()) == 0);
+        bool valid = next_id(oid);
         if (valid)
             git_oid_fmt(id_buffer, &oid);
         return valid;
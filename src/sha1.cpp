@@ -0,0 +1,115 @@
+#include "sha1.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace git {
+namespace internal
+{
+    namespace
+    {
+        uint32_t rotate_left(uint32_t value, int count)
+        {
+            return (value << count) | (value >> (32 - count));
+        }
+    }
+
+    Sha1::Sha1()
+        : h_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0}
+    {
+    }
+
+    void Sha1::block(unsigned char const * p)
+    {
+        uint32_t w[80];
+        for (int i = 0; i != 16; ++i)
+            w[i] = (uint32_t(p[4 * i]) << 24) | (uint32_t(p[4 * i + 1]) << 16) | (uint32_t(p[4 * i + 2]) << 8) | uint32_t(p[4 * i + 3]);
+        for (int i = 16; i != 80; ++i)
+            w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h_[0], b = h_[1], c = h_[2], d = h_[3], e = h_[4];
+        for (int i = 0; i != 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            const uint32_t t = rotate_left(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotate_left(b, 30);
+            b = a;
+            a = t;
+        }
+
+        h_[0] += a;
+        h_[1] += b;
+        h_[2] += c;
+        h_[3] += d;
+        h_[4] += e;
+    }
+
+    void Sha1::update(void const * data, size_t size)
+    {
+        auto p = static_cast<unsigned char const *>(data);
+        total_ += size;
+
+        if (buffered_)
+        {
+            const size_t n = std::min(size, sizeof(buf_) - buffered_);
+            std::memcpy(buf_ + buffered_, p, n);
+            buffered_ += n;
+            p += n;
+            size -= n;
+            if (buffered_ != sizeof(buf_))
+                return;
+            block(buf_);
+            buffered_ = 0;
+        }
+
+        for (; size >= sizeof(buf_); p += sizeof(buf_), size -= sizeof(buf_))
+            block(p);
+
+        std::memcpy(buf_, p, size);
+        buffered_ = size;
+    }
+
+    void Sha1::final(unsigned char (&out)[20])
+    {
+        const uint64_t bits = total_ * 8;
+
+        unsigned char padding[72] = {0x80};
+        const size_t padding_size = (buffered_ < 56 ? 56 : 120) - buffered_;
+        update(padding, padding_size);
+
+        unsigned char length[8];
+        for (int i = 0; i != 8; ++i)
+            length[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+        update(length, sizeof(length));
+
+        for (int i = 0; i != 5; ++i)
+        {
+            out[4 * i] = static_cast<unsigned char>(h_[i] >> 24);
+            out[4 * i + 1] = static_cast<unsigned char>(h_[i] >> 16);
+            out[4 * i + 2] = static_cast<unsigned char>(h_[i] >> 8);
+            out[4 * i + 3] = static_cast<unsigned char>(h_[i]);
+        }
+    }
+}}
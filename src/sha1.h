@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace git {
+namespace internal
+{
+    /// Plain SHA-1 of a byte stream, for trailing file checksums; libgit2 only hashes objects
+    struct Sha1
+    {
+        Sha1();
+
+        void update(void const * data, size_t size);
+        void final(unsigned char (&out)[20]);
+
+    private:
+        void block(unsigned char const * p);
+
+    private:
+        uint32_t h_[5];
+        unsigned char buf_[64];
+        size_t buffered_ = 0;
+        uint64_t total_ = 0;
+    };
+}}
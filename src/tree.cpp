@@ -3,6 +3,14 @@
 #include "git2cpp/repo.h"
 
 #include <git2/errors.h>
+#include <git2/repository.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace git
 {
@@ -55,6 +63,106 @@ namespace git
         }
     }
 
+    void Tree::walk(git_repository * repo, git_tree const * tree, std::string & path, WalkVisitor const & visitor)
+    {
+        const size_t dir_size = path.size();
+        const size_t count = git_tree_entrycount(tree);
+        for (size_t i = 0; i != count; ++i)
+        {
+            auto entry = git_tree_entry_byindex(tree, i);
+            path.resize(dir_size);
+            path += git_tree_entry_name(entry);
+
+            if (!visitor(path.c_str(), BorrowedEntry(entry)) || git_tree_entry_type(entry) != GIT_OBJECT_TREE)
+                continue;
+
+            git_tree * subtree;
+            if (git_tree_lookup(&subtree, repo, git_tree_entry_id(entry)))
+                throw tree_lookup_error(*git_tree_entry_id(entry));
+            std::unique_ptr<git_tree, Destroy> holder(subtree);
+            path += '/';
+            walk(repo, subtree, path, visitor);
+        }
+        path.resize(dir_size);
+    }
+
+    void Tree::walk(WalkVisitor const & visitor) const
+    {
+        std::string path;
+        walk(git_tree_owner(ptr()), ptr(), path, visitor);
+    }
+
+    void Tree::walk(WalkVisitor const & visitor, unsigned int workers) const
+    {
+        // entries of this tree are visited here; the subtrees below them are the units of work
+        std::vector<git_tree_entry const *> subtrees;
+        const size_t count = entrycount();
+        std::string path;
+        for (size_t i = 0; i != count; ++i)
+        {
+            auto entry = git_tree_entry_byindex(ptr(), i);
+            path = git_tree_entry_name(entry);
+            if (visitor(path.c_str(), BorrowedEntry(entry)) && git_tree_entry_type(entry) == GIT_OBJECT_TREE)
+                subtrees.push_back(entry);
+        }
+
+        auto descend = [&visitor] (git_repository * repo, git_tree_entry const * entry, std::string & path)
+        {
+            git_tree * subtree;
+            if (git_tree_lookup(&subtree, repo, git_tree_entry_id(entry)))
+                throw tree_lookup_error(*git_tree_entry_id(entry));
+            std::unique_ptr<git_tree, Destroy> holder(subtree);
+            path = git_tree_entry_name(entry);
+            path += '/';
+            walk(repo, subtree, path, visitor);
+        };
+
+        if (workers < 2 || subtrees.size() < 2 || repo_->has_in_memory_odb())
+        {
+            for (auto entry : subtrees)
+                descend(git_tree_owner(ptr()), entry, path);
+            return;
+        }
+
+        const std::string gitdir = git_repository_path(git_tree_owner(ptr()));
+        std::atomic<size_t> next(0);
+        std::mutex error_mutex;
+        std::exception_ptr error;
+
+        auto worker = [&]
+        {
+            try
+            {
+                git_repository * raw;
+                if (git_repository_open(&raw, gitdir.c_str()))
+                    throw repository_open_error(gitdir);
+                std::unique_ptr<git_repository, void (*)(git_repository *)> repo(raw, git_repository_free);
+
+                std::string path;
+                for (size_t i; (i = next++) < subtrees.size(); )
+                    descend(repo.get(), subtrees[i], path);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                next = subtrees.size();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        const size_t threads_count = std::min<size_t>(workers, subtrees.size());
+        threads.reserve(threads_count);
+        for (size_t i = 0; i != threads_count; ++i)
+            threads.emplace_back(worker);
+        for (auto & thread : threads)
+            thread.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
     Tree::OwnedEntry::OwnedEntry(git_tree_entry * entry, Repository const & repo)
         : entry_(entry)
         , repo_(&repo)
@@ -0,0 +1,76 @@
+#include "git2cpp/tree_builder.h"
+#include "git2cpp/error.h"
+#include "git2cpp/tree.h"
+
+#include <git2/blob.h>
+#include <git2/object.h>
+
+#include <vector>
+
+namespace git
+{
+    TreeBuilder::TreeBuilder(git_repository * repo, Repository const & owner, git_tree const * base)
+        : repo_(repo)
+        , owner_(&owner)
+    {
+        if (base)
+        {
+            git_object * copy;
+            git_object_dup(&copy, reinterpret_cast<git_object *>(const_cast<git_tree *>(base)));
+            base_.reset(reinterpret_cast<git_tree *>(copy));
+        }
+    }
+
+    void TreeBuilder::Destroy::operator()(git_tree * tree) const
+    {
+        git_tree_free(tree);
+    }
+
+    TreeBuilder & TreeBuilder::upsert(std::string path, git_oid const & blob, git_filemode_t mode)
+    {
+        git_tree_update & update = updates_[std::move(path)];
+        update.action = GIT_TREE_UPDATE_UPSERT;
+        update.id = blob;
+        update.filemode = mode;
+        return *this;
+    }
+
+    TreeBuilder & TreeBuilder::upsert(std::string path, const void * data, size_t size, git_filemode_t mode)
+    {
+        git_oid blob;
+        if (git_blob_create_from_buffer(&blob, repo_, data, size))
+            throw odb_write_error();
+        return upsert(std::move(path), blob, mode);
+    }
+
+    TreeBuilder & TreeBuilder::remove(std::string path)
+    {
+        git_tree_update & update = updates_[std::move(path)];
+        update.action = GIT_TREE_UPDATE_REMOVE;
+        return *this;
+    }
+
+    Tree TreeBuilder::write()
+    {
+        std::vector<git_tree_update> updates;
+        updates.reserve(updates_.size());
+        for (auto & u : updates_)
+        {
+            updates.push_back(u.second);
+            updates.back().path = u.first.c_str();
+        }
+
+        git_oid id;
+        if (git_tree_create_updated(&id, repo_, base_.get(), updates.size(), updates.data()))
+            throw tree_create_error();
+        updates_.clear();
+
+        git_tree * tree;
+        if (git_tree_lookup(&tree, repo_, &id))
+            throw tree_lookup_error(id);
+        git_object * copy;
+        git_object_dup(&copy, reinterpret_cast<git_object *>(tree));
+        base_.reset(reinterpret_cast<git_tree *>(copy));
+        return Tree(tree, *owner_);
+    }
+}
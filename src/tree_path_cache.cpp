@@ -0,0 +1,69 @@
+#include "git2cpp/tree_path_cache.h"
+#include "git2cpp/error.h"
+
+#include <git2/object.h>
+#include <git2/tree.h>
+
+namespace git
+{
+    void TreePathCache::Destroy::operator()(git_tree * tree) const
+    {
+        git_tree_free(tree);
+    }
+
+    TreePathCache::TreePathCache(Tree const & root)
+    {
+        git_object * copy;
+        git_object_dup(&copy, reinterpret_cast<git_object *>(const_cast<git_tree *>(root.ptr())));
+        trees_.emplace_back(reinterpret_cast<git_tree *>(copy));
+        dirs_.emplace(std::string_view(), trees_.back().get());
+    }
+
+    git_oid const & TreePathCache::root_id() const
+    {
+        return *git_tree_id(trees_.front().get());
+    }
+
+    git_tree const * TreePathCache::dir(std::string_view path)
+    {
+        auto it = dirs_.find(path);
+        if (it != dirs_.end())
+            return it->second;
+
+        const size_t slash = path.rfind('/');
+        const auto parent_path = slash == std::string_view::npos ? std::string_view() : path.substr(0, slash);
+        const auto name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+
+        git_tree const * result = nullptr;
+        if (auto parent = dir(parent_path))
+        {
+            const std::string name_str(name);
+            auto entry = git_tree_entry_byname(parent, name_str.c_str());
+            if (entry && git_tree_entry_type(entry) == GIT_OBJECT_TREE)
+            {
+                git_tree * tree;
+                if (git_tree_lookup(&tree, git_tree_owner(parent), git_tree_entry_id(entry)))
+                    throw tree_lookup_error(*git_tree_entry_id(entry));
+                trees_.emplace_back(tree);
+                result = tree;
+            }
+        }
+
+        dir_names_.emplace_back(path);
+        dirs_.emplace(dir_names_.back(), result);
+        return result;
+    }
+
+    internal::optional<Tree::BorrowedEntry> TreePathCache::find(std::string_view path)
+    {
+        const size_t slash = path.rfind('/');
+        auto tree = dir(slash == std::string_view::npos ? std::string_view() : path.substr(0, slash));
+        if (!tree)
+            return internal::none;
+
+        const std::string name(slash == std::string_view::npos ? path : path.substr(slash + 1));
+        if (auto entry = git_tree_entry_byname(tree, name.c_str()))
+            return Tree::BorrowedEntry(entry);
+        return internal::none;
+    }
+}
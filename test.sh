@@ -18,6 +18,11 @@ if [ ! -d $REPO ]; then
 fi
 
 CWD=${PWD}
+EXAMPLES="$CWD/examples"
+FAILED=0
+
+TMP_DIR=$(mktemp -d)
+trap 'rm -rf "$TMP_DIR"' EXIT
 
 function test()
 {
@@ -36,6 +41,29 @@ function test()
     echo -e "\nexit status $exit_status \n\n"
 }
 
+# runs two commands (usually an example and git) and checks that they print the same
+function compare()
+{
+    local test_name="$1"
+    echo -e "**** compare $test_name *********************************\n\n"
+
+    if diff -u <(eval "$2") <(eval "$3"); then
+        echo -e "same output\n\n"
+    else
+        echo -e "\ndifferent output\n\n"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+# paths of HEAD for path-limited walks: a few top-level files and a directory, a nested file and a nested directory
+function sample_paths()
+{
+    (git ls-tree --name-only HEAD | head -3
+     git ls-tree -d --name-only HEAD | head -1
+     git ls-tree -r --name-only HEAD | grep / | head -1
+     git ls-tree -r -d --name-only HEAD | grep / | head -1) | sort -u
+}
+
 # read-only tests (repo shouldn't be bare)
 pushd $REPO
 
@@ -48,15 +76,155 @@ test rev-parse-cpp HEAD
 test showindex-cpp
 test status-cpp
 
+compare "showindex -s" "git -c core.quotePath=false ls-files -s" "$EXAMPLES/showindex-cpp -s"
+compare "for-each-ref" "git for-each-ref --format='%(objectname) %(refname)'" "$EXAMPLES/for-each-ref-cpp"
+compare "for-each-ref refs/tags/" "git for-each-ref --format='%(objectname) %(refname)' refs/tags/" "$EXAMPLES/for-each-ref-cpp . refs/tags/"
+compare "rev-list --parents" "git rev-list --parents HEAD | sort" "$EXAMPLES/rev-list-cpp --parents HEAD | sort"
+
+# directories listed through Index::prefix_range: a top-level one, a nested one and a missing one
+for dir in $( (git ls-tree -d --name-only HEAD | head -1; git ls-tree -r -d --name-only HEAD | grep / | head -1) | sort -u) no-such-dir; do
+    compare "ls-files $dir/" "git -c core.quotePath=false ls-files $dir/" "$EXAMPLES/ls-files-cpp $dir/"
+done
+
+# path-limited walks
+for path in $(sample_paths); do
+    compare "log -- $path" "git log --format=%H -- $path | sort" "$EXAMPLES/log-cpp --format=%H -- $path | sort"
+    compare "log --full-history -- $path" "git log --format=%H --full-history -- $path | sort" "$EXAMPLES/log-cpp --format=%H --full-history -- $path | sort"
+done
+
+popd
+
+# same walks in a clone whose commit-graph has changed-path filters
+git clone -q --no-local $REPO "$TMP_DIR/filters"
+pushd "$TMP_DIR/filters"
+
+git commit-graph write --reachable --changed-paths
+for path in $(sample_paths); do
+    compare "log -- $path (changed-path filters)" "git log --format=%H -- $path | sort" "$EXAMPLES/log-cpp --format=%H -- $path | sort"
+    compare "log --full-history -- $path (changed-path filters)" "git log --format=%H --full-history -- $path | sort" "$EXAMPLES/log-cpp --format=%H --full-history -- $path | sort"
+    compare "log --first-parent -- $path (changed-path filters)" "git log --format=%H --first-parent -- $path | sort" "$EXAMPLES/log-cpp --format=%H --first-parent -- $path | sort"
+done
+
+popd
+
+# a commit-graph chain written by the library, read by git and by the library
+git clone -q --no-local $REPO "$TMP_DIR/written-filters"
+pushd "$TMP_DIR/written-filters"
+
+test commit-graph-cpp write --split
+compare "commit-graph verify" "echo 0" "git commit-graph verify; echo \$?"
+for path in $(sample_paths); do
+    compare "git log -- $path (written filters)" "git -c core.commitGraph=false log --format=%H -- $path" "git log --format=%H -- $path"
+    compare "log -- $path (written filters)" "git log --format=%H -- $path | sort" "$EXAMPLES/log-cpp --format=%H -- $path | sort"
+done
+
 popd
 
+# parallel checkout: the example must leave the same work tree and index as git checkout
+for clone in checked-out expected-checkout; do
+    git clone -q --no-local $REPO "$TMP_DIR/$clone"
+done
+TARGET=$(git -C $REPO rev-list --max-count=10 HEAD | tail -1)
+START=$(git -C "$TMP_DIR/checked-out" symbolic-ref --short HEAD)
+git -C "$TMP_DIR/expected-checkout" checkout -q --detach $TARGET
+pushd "$TMP_DIR/checked-out"
+test checkout-cpp --no-progress --jobs=4 $TARGET
+popd
+compare "checkout --jobs=4 (status)" "git -C $TMP_DIR/expected-checkout status --porcelain --branch" "git -C $TMP_DIR/checked-out status --porcelain --branch"
+compare "checkout --jobs=4 (index)" "git -C $TMP_DIR/expected-checkout ls-files -s" "git -C $TMP_DIR/checked-out ls-files -s"
+
+git -C "$TMP_DIR/expected-checkout" checkout -q --force $START
+pushd "$TMP_DIR/checked-out"
+test checkout-cpp --force --no-progress --jobs=4 $START
+popd
+compare "checkout --force --jobs=4 (status)" "git -C $TMP_DIR/expected-checkout status --porcelain --branch" "git -C $TMP_DIR/checked-out status --porcelain --branch"
+compare "checkout --force --jobs=4 (index)" "git -C $TMP_DIR/expected-checkout ls-files -s" "git -C $TMP_DIR/checked-out ls-files -s"
+
+# fetching: clones fetched by the example must end up with the same refs as one fetched by git
+# fetched-pruned is up to date except for a deleted branch: only pruning and FETCH_HEAD are left to do
+git clone -q --no-local $REPO "$TMP_DIR/upstream"
+git -C "$TMP_DIR/upstream" branch fetch-test-pruned
+for clone in fetched fetched-changed expected; do
+    git clone -q "$TMP_DIR/upstream" "$TMP_DIR/$clone"
+    git -C "$TMP_DIR/$clone" config remote.origin.prune true
+done
+git -C "$TMP_DIR/upstream" -c user.name=test -c user.email=test@example.com commit -q --allow-empty -m "fetch test"
+git -C "$TMP_DIR/upstream" -c user.name=test -c user.email=test@example.com tag -a -m "fetch test" fetch-test-annotated
+git -C "$TMP_DIR/upstream" tag fetch-test-lightweight
+for clone in fetched-pruned expected-pruned; do
+    git clone -q "$TMP_DIR/upstream" "$TMP_DIR/$clone"
+    git -C "$TMP_DIR/$clone" config remote.origin.prune true
+done
+git -C "$TMP_DIR/upstream" branch -q -D fetch-test-pruned
+git -C "$TMP_DIR/expected" fetch -q
+git -C "$TMP_DIR/expected-pruned" fetch -q
+
+test fetch-cpp --jobs=2 "$TMP_DIR/fetched"
+test fetch-cpp --only-changed "$TMP_DIR/fetched-changed"
+test fetch-cpp --only-changed "$TMP_DIR/fetched-changed"
+test fetch-cpp --only-changed "$TMP_DIR/fetched-pruned"
+compare "fetch" "git -C $TMP_DIR/expected for-each-ref" "git -C $TMP_DIR/fetched for-each-ref"
+compare "fetch --only-changed" "git -C $TMP_DIR/expected for-each-ref" "git -C $TMP_DIR/fetched-changed for-each-ref"
+compare "fetch --only-changed (pruned)" "git -C $TMP_DIR/expected-pruned for-each-ref" "git -C $TMP_DIR/fetched-pruned for-each-ref"
+compare "fetch --only-changed (FETCH_HEAD)" "cat $TMP_DIR/expected-pruned/.git/FETCH_HEAD" "cat $TMP_DIR/fetched-pruned/.git/FETCH_HEAD"
+
+# shallow clones: as much history as git clone --depth=1 fetches; libgit2 supports them from 1.7 on
+REPO_URL="file://$(cd $REPO && pwd)"
+if $EXAMPLES/clone-cpp --depth=1 "$REPO_URL" "$TMP_DIR/shallow" | grep -q "requires libgit2 1.7"; then
+    echo -e "skipped clone --depth=1: libgit2 is older than 1.7\n\n"
+else
+    git clone -q --depth=1 "$REPO_URL" "$TMP_DIR/expected-shallow"
+    compare "clone --depth=1" "git -C $TMP_DIR/expected-shallow rev-list --count HEAD" "git -C $TMP_DIR/shallow rev-list --count HEAD"
+fi
+
+# ref transactions: the example must leave the same refs as git update-ref --stdin,
+# also when the old value of one ref doesn't match and nothing may be written
+for clone in updated expected-updates reftable expected-reftable; do
+    git clone -q --no-local $REPO "$TMP_DIR/$clone"
+    git -C "$TMP_DIR/$clone" update-ref refs/heads/update-ref-delete HEAD
+done
+NEW=$(git -C $REPO rev-parse HEAD)
+OLD=$(git -C $REPO rev-list --max-count=2 HEAD | tail -1)
+BRANCH=$(git -C "$TMP_DIR/updated" symbolic-ref HEAD)
+
+UPDATES="create refs/heads/update-ref-create $OLD
+update $BRANCH $OLD $NEW
+delete refs/heads/update-ref-delete $NEW"
+CONFLICTING="create refs/heads/update-ref-conflict $NEW
+update $BRANCH $NEW $NEW"
+
+git -C "$TMP_DIR/expected-updates" update-ref --stdin <<< "$UPDATES"
+test update-ref-cpp "$TMP_DIR/updated" <<< "$UPDATES"
+compare "update-ref" "git -C $TMP_DIR/expected-updates for-each-ref" "git -C $TMP_DIR/updated for-each-ref"
+
+git -C "$TMP_DIR/expected-updates" update-ref --stdin <<< "$CONFLICTING" 2> /dev/null
+test update-ref-cpp "$TMP_DIR/updated" <<< "$CONFLICTING"
+compare "update-ref with a conflict" "git -C $TMP_DIR/expected-updates for-each-ref" "git -C $TMP_DIR/updated for-each-ref"
+
+# reftable: refs migrated by the example must read and update like those of a clone left alone;
+# git reads the reftable itself only from version 2.45 on
+test refs-cpp migrate --ref-format=reftable "$TMP_DIR/reftable"
+FOR_EACH_REF="for-each-ref --format='%(objectname) %(refname)'"
+compare "for-each-ref (reftable)" "git -C $TMP_DIR/expected-reftable $FOR_EACH_REF" "$EXAMPLES/for-each-ref-cpp $TMP_DIR/reftable"
+compare "rev-parse HEAD (reftable)" "git -C $TMP_DIR/expected-reftable rev-parse HEAD" "cd $TMP_DIR/reftable && $EXAMPLES/rev-parse-cpp HEAD"
+compare "log (reftable)" "git -C $TMP_DIR/expected-reftable log --format=%H | sort" "cd $TMP_DIR/reftable && $EXAMPLES/log-cpp --format=%H | sort"
+
+for updates in "$UPDATES" "$CONFLICTING"; do
+    git -C "$TMP_DIR/expected-reftable" update-ref --stdin <<< "$updates" 2> /dev/null
+    test update-ref-cpp "$TMP_DIR/reftable" <<< "$updates"
+    compare "update-ref (reftable)" "git -C $TMP_DIR/expected-reftable $FOR_EACH_REF" "$EXAMPLES/for-each-ref-cpp $TMP_DIR/reftable"
+done
+if git -C "$TMP_DIR/reftable" for-each-ref > /dev/null 2>&1; then
+    compare "git for-each-ref (reftable)" "git -C $TMP_DIR/expected-reftable for-each-ref" "git -C $TMP_DIR/reftable for-each-ref"
+fi
+
 # write test (use libgit2/tests/resources/testrepo.git)
 
 RW_REPO=$2
 
 if [ -z $RW_REPO ]; then
 	echo "no writable repo specified"
-	exit 0
+	exit $((FAILED > 0))
 fi
 
 pushd $RW_REPO
@@ -66,3 +234,5 @@ test cat-file-cpp -p a8233120f6ad708f843d861ce2b7228ec4e3dec6
 test general-cpp .
 
 popd
+
+exit $((FAILED > 0))